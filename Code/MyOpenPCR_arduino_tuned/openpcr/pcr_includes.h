@@ -49,6 +49,11 @@ enum PcrStatus {
 
 #define SUCCEEDED(status) (status == ESuccess)
 
+//thermistor tables hold fixed point hundredths of a degree C
+typedef int16_t TTemp;
+#define TEMP_SCALE 100
+#define TEMP_C(degrees) ((TTemp)((degrees) * TEMP_SCALE))
+
 void sprintFloat(char* str, float val, int decimalDigits, boolean pad);
 unsigned short htons(unsigned short val);
 double absf(double val);
@@ -18,41 +18,28 @@
 
 #include "pcr_includes.h"
 #include "thermistors.h"
+#include "thermistor_table.h"
 
-// lid resistance table, in Ohms
-PROGMEM const unsigned int LID_RESISTANCE_TABLE[] = {  
-28704,27417,26197,25039,23940,22897,21906,20964,20070,19219,
-18410,17641,16909,16212,15548,14916,14313,13739,13192,12669,
-12171,11696,11242,10809,10395,10000,9622,9261,8916,8585,
-8269,7967,7678,7400,7135,6881,6637,6403,6179,5965,
-5759,5561,5372,5189,5015,4847,4686,4531,4382,4239,
-4101,3969,3842,3719,3601,3488,3379,3274,3172,3075,
-2981,2890,2803,2719,2638,2559,2484,2411,2341,2273,
-2207,2144,2083,2024,1967,1912,1858,1807,1757,1709,
-1662,1617,1574,1532,1491,1451,1413,1376,1340,1305,
-1272,1239,1208,1177,1147,1118,1091,1063,1037,1012,
-987,963,940,917,895,874,853,833,814,795,
-776,758,741,724,708,692,676,661,646,632,
-618,604,591,578,566,554
+// thermistor: 10k NTC, Beta 3435, below a 2.2k pull-up to the ADC reference
+struct SNtc10kThermistor {
+  static constexpr double A = BetaA(10000, 3435);
+  static constexpr double B = BetaB(3435);
+  static constexpr double C = 0;
+  static constexpr double PULL_UP_OHMS = 2200;
 };
 
-// plate resistance table, in 0.1 Ohms
-PROGMEM const unsigned long PLATE_RESISTANCE_TABLE[] = {
-248277,233136,219036,205897,193648,182221,171556,161596,152290,143590,
-135452,127837,120707,114028,107768,101898,96391,91222,86369,81809,
-77523,73492,69701,66132,62771,59606,56623,53810,51157,48654,
-46290,44058,41950,39957,38072,36290,34603,33006,31494,30062,
-28704,27417,26197,25039,23940,22897,21906,20964,20070,19219,
-18410,17641,16909,16212,15548,14916,14313,13739,13192,12669,
-12171,11696,11242,10809,10395,10000,9622,9261,8916,8585,
-8269,7967,7678,7400,7135,6881,6637,6403,6179,5965,
-5759,5561,5372,5189,5015,4847,4686,4531,4382,4239,
-4101,3969,3842,3719,3601,3488,3379,3274,3172,3075,
-2981,2890,2803,2719,2638,2559,2484,2411,2341,2273,
-2207,2144,2083,2024,1967,1912,1858,1807,1757,1709,
-1662,1617,1574,1532,1491,1451,1413,1376,1340,1305,
-1272,1239,1208,1177,1147,1118,1091,1063,1037,1012,
-987,963,940,917,895,874
+// lid: 10 bit ATmega ADC
+struct SLidSensor: SNtc10kThermistor {
+  static constexpr unsigned long ADC_FULL_SCALE = 1024;
+  static const uint8_t CODE_BITS = 10;
+  static const uint8_t TABLE_BITS = 7;
+};
+
+// plate: 21 bit LTC2400 class ADC
+struct SPlateSensor: SNtc10kThermistor {
+  static constexpr unsigned long ADC_FULL_SCALE = 0x1FFFFF;
+  static const uint8_t CODE_BITS = 21;
+  static const uint8_t TABLE_BITS = 8;
 };
   
 //spi
@@ -61,40 +48,9 @@ PROGMEM const unsigned long PLATE_RESISTANCE_TABLE[] = {
 #define SPICLOCK  13//sck
 #define SLAVESELECT 10//ss
 
-//------------------------------------------------------------------------------
-float TableLookup(const unsigned long lookupTable[], unsigned int tableSize, int startValue, unsigned long searchValue) {
-  //simple linear search for now
-  int i;
-  for (i = 0; i < tableSize; i++) {
-    if (searchValue >= pgm_read_dword_near(lookupTable + i))
-      break;
-  }
-  
-  if (i > 0) {
-    unsigned long high_val = pgm_read_dword_near(lookupTable + i - 1);
-    unsigned long low_val = pgm_read_dword_near(lookupTable + i);
-    return i + startValue - (float)(searchValue - low_val) / (float)(high_val - low_val);
-  } else {
-    return startValue;
-  }
-}
-//------------------------------------------------------------------------------
-float TableLookup(const unsigned int lookupTable[], unsigned int tableSize, int startValue, unsigned long searchValue) {
-  //simple linear search for now
-  int i;
-  for (i = 0; i < tableSize; i++) {
-    if (searchValue >= pgm_read_word_near(lookupTable + i))
-      break;
-  }
-  
-  if (i > 0) {
-    unsigned long high_val = pgm_read_word_near(lookupTable + i - 1);
-    unsigned long low_val = pgm_read_word_near(lookupTable + i);
-    return i + startValue - (float)(searchValue - low_val) / (float)(high_val - low_val);
-  } else {
-    return startValue;
-  }
-}
+// LTC2400 status bits, above the data in the first byte of the frame
+#define LTC2400_SIG 0x20 // input above ground
+#define LTC2400_EXR 0x10 // input outside 0 to the reference
 
 ////////////////////////////////////////////////////////////////////
 // Class CLidThermistor
@@ -103,10 +59,7 @@ CLidThermistor::CLidThermistor():
 }
 //------------------------------------------------------------------------------
 void CLidThermistor::ReadTemp() {
-  unsigned long voltage_mv = (unsigned long)analogRead(1) * 5000 / 1024;
-  unsigned long resistance = voltage_mv * 2200 / (5000 - voltage_mv);
-  
-  iTemp = TableLookup(LID_RESISTANCE_TABLE, sizeof(LID_RESISTANCE_TABLE) / sizeof(LID_RESISTANCE_TABLE[0]), 0, resistance);
+  iTemp = (double)LookupTemp<SLidSensor>(analogRead(1)) / TEMP_SCALE;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -135,19 +88,14 @@ void CPlateThermistor::ReadTemp() {
   for(int i = 0; i < 4; i++)
     spiBuf[i] = SPITransfer(0xFF);
 
-  unsigned long conv = (((unsigned long)spiBuf[3] >> 7) & 0x01) + ((unsigned long)spiBuf[2] << 1) + ((unsigned long)spiBuf[1] << 9) + (((unsigned long)spiBuf[0] & 0x1F) << 17); //((spiBuf[0] & 0x1F) << 16) + (spiBuf[1] << 8) + spiBuf[2];
-  
-  unsigned long adcDivisor = 0x1FFFFF;
-  float voltage = (float)conv * 5.0 / adcDivisor;
-
-  unsigned int convHigh = (conv >> 16);
+  unsigned long conv = (((unsigned long)spiBuf[3] >> 7) & 0x01) + ((unsigned long)spiBuf[2] << 1) + ((unsigned long)spiBuf[1] << 9) + (((unsigned long)spiBuf[0] & 0x0F) << 17); //((spiBuf[0] & 0x1F) << 16) + (spiBuf[1] << 8) + spiBuf[2];
   
   digitalWrite(SLAVESELECT, HIGH);
   
-  unsigned long voltage_mv = voltage * 1000;
-  unsigned long resistance = voltage_mv * 2200 / (5000 - voltage_mv); // in hecto ohms
- 
-  iTemp = TableLookup(PLATE_RESISTANCE_TABLE, sizeof(PLATE_RESISTANCE_TABLE) / sizeof(PLATE_RESISTANCE_TABLE[0]), -40, resistance);
+  //EXR flags an input past the reference, or below ground when SIG is clear
+  if (spiBuf[0] & LTC2400_EXR)
+    conv = (spiBuf[0] & LTC2400_SIG) ? SPlateSensor::ADC_FULL_SCALE : 0;
+  iTemp = (double)LookupTemp<SPlateSensor>(conv) / TEMP_SCALE;
 }
 //------------------------------------------------------------------------------
 char CPlateThermistor::SPITransfer(volatile char data) {
@@ -150,11 +150,15 @@ void Display::Update() {
       sprintf_P(buf, VERSION_FORM_STR, OPENPCR_FIRMWARE_VERSION_STRING);
       iLcd.print(buf);
     break;
+    
+  case Thermocycler::EError:
+  case Thermocycler::EClear:
+    break;
   }
 }
 
 void Display::DisplayEta() {
-  char timeString[16];
+  char timeString[24];
   unsigned long timeRemaining = GetThermocycler().GetTimeRemainingS();
   int hours = timeRemaining / 3600;
   int mins = (timeRemaining % 3600) / 60;
@@ -180,7 +184,7 @@ void Display::DisplayLidTemp() {
 }
 
 void Display::DisplayBlockTemp() {
-  char buf[16];
+  char buf[20];
   char floatStr[16];
   
   sprintFloat(floatStr, GetThermocycler().GetPlateTemp(), 1, true);
@@ -220,6 +224,7 @@ void Display::DisplayState() {
       stateStr = GetThermocycler().GetCurrentStep()->GetName();
       break;
     case Thermocycler::EIdle:
+    default:
       stateStr = rps(STOPPED_STR);
       break;
     }
@@ -228,6 +233,9 @@ void Display::DisplayState() {
   case Thermocycler::EStopped:
     stateStr = rps(STOPPED_STR);
     break;
+    
+  default:
+    return; //no state line
   }
   
   iLcd.setCursor(0, 0);
@@ -25,8 +25,8 @@ CPIDController::CPIDController(const SPIDTuning* pGainSchedule, int minOutput, i
   ipGainSchedule(pGainSchedule),
   iMinOutput(minOutput),
   iMaxOutput(maxOutput),
-  iIntegrator(0),
-  iPreviousError(0) {
+  iPreviousError(0),
+  iIntegrator(0) {
 }
 //------------------------------------------------------------------------------
 double CPIDController::Compute(double target, double currentValue) {
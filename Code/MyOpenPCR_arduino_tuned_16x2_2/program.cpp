@@ -108,8 +108,7 @@ void Cycle::RestartCycle() {
 // Class CommandParser
 void CommandParser::ParseCommand(SCommand& command, char* pCommandBuf) {
   char* pValue;
-  memset(&command, NULL, sizeof(command));
-  char buf[32];
+  memset(&command, 0, sizeof(command));
 
   gpThermocycler->Stop(); //need to stop here to reset program pools
     
@@ -185,7 +184,8 @@ ProgramComponent* CommandParser::ParseCycle(char* pBuffer) {
     *pStepEnd++ = '\0';
 
     Step* pNewStep = ParseStep(pStep);
-    pCycle->AddComponent(pNewStep);
+    if (pNewStep != NULL)
+      pCycle->AddComponent(pNewStep);
     pStep = strchr(pStepEnd, '[');
   }
 
@@ -217,6 +217,8 @@ Step* CommandParser::ParseStep(char* pBuffer) {
   float temp = atof(pTemp);
 
   Step* pStep = gpThermocycler->GetStepPool().AllocateComponent();
+  if (pStep == NULL)
+    return NULL; //the pool is used up, the step is left out
   
   pStep->SetName(pName);
   pStep->SetStepDurationS(stepDuration);
@@ -27,14 +27,14 @@
 #define BAUD_RATE 4800
 
 SerialControl::SerialControl(Display* pDisplay)
-: ipDisplay(pDisplay)
-, packetState(STATE_START)
+: packetState(STATE_START)
+, lastPacketSeq(0xff)
 , packetLen(0)
 , packetRealLen(0)
-, lastPacketSeq(0xff)
-, bEscapeCodeFound(false)
 , iCommandId(0)
+, bEscapeCodeFound(false)
 , iReceivedStatusRequest(false)
+, ipDisplay(pDisplay)
 {  
   Serial.begin(BAUD_RATE);
 }
@@ -122,7 +122,6 @@ void SerialControl::ProcessPacket(byte* data, int datasize)
   PCPPacket* packet = (PCPPacket*)data;
   uint8_t packetType = packet->eType & 0xf0;
   uint8_t packetSeq = packet->eType & 0x0f;
-  uint8_t result = false;
   char* pCommandBuf;
   
   switch(packetType){
@@ -177,7 +176,7 @@ void SerialControl::SendStatus() {
     if (tc.GetCurrentStep() != NULL)
       statusPtr = AddParam(statusPtr, 'p', tc.GetCurrentStep()->GetName());
       
-  } else if (state == Thermocycler::EIdle) {
+  } else if (state == Thermocycler::EStartup) {
     statusPtr = AddParam(statusPtr, 'v', OPENPCR_FIRMWARE_VERSION_STRING);
   }
   statusPtr++; //to include null terminator
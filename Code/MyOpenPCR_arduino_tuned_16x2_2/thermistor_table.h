@@ -0,0 +1,111 @@
+/*
+ *  thermistor_table.h - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THERMISTOR_TABLE_H_
+#define _THERMISTOR_TABLE_H_
+
+// Thermistor temperature tables are generated at compile time from a sensor
+// model and indexed by the top bits of the ADC code, so a conversion is a single
+// interpolation between two entries. A model is a struct with:
+//
+//   A, B, C          Steinhart-Hart coefficients, 1/T = A + B ln(R) + C ln(R)^3
+//   PULL_UP_OHMS     divider resistor from the ADC reference to the thermistor,
+//                    the thermistor goes to ground
+//   ADC_FULL_SCALE   ADC code at the reference voltage
+//   CODE_BITS        ADC code width
+//   TABLE_BITS       the table has 2^TABLE_BITS + 1 entries
+//
+// Entries are TTemp, clamped to THERMISTOR_MIN_TEMP..THERMISTOR_MAX_TEMP.
+
+#define THERMISTOR_MIN_TEMP -100
+#define THERMISTOR_MAX_TEMP 300
+#define KELVIN_OFFSET 273.15
+#define LN_2 0.69314718055994531
+
+//natural log for constant expressions: scale x into [1, 2), then ln(x) = 2 atanh((x - 1) / (x + 1))
+constexpr double ConstLnSeries(double y2, double term, int n) {
+  return n > 41 ? 0 : term / n + ConstLnSeries(y2, term * y2, n + 2);
+}
+constexpr double ConstLn(double x) {
+  return x >= 2 ? ConstLn(x / 2) + LN_2 :
+         x < 1 ? ConstLn(x * 2) - LN_2 :
+         2 * ConstLnSeries(((x - 1) / (x + 1)) * ((x - 1) / (x + 1)), (x - 1) / (x + 1), 1);
+}
+
+//Steinhart-Hart coefficients of a Beta model, C is 0
+constexpr double BetaA(double r25Ohms, double beta) { return 1 / (25 + KELVIN_OFFSET) - ConstLn(r25Ohms) / beta; }
+constexpr double BetaB(double beta) { return 1 / beta; }
+
+constexpr double DegreesFromInverseKelvin(double inverseKelvin) {
+  return inverseKelvin <= 1 / (THERMISTOR_MAX_TEMP + KELVIN_OFFSET) ? THERMISTOR_MAX_TEMP :
+         inverseKelvin >= 1 / (THERMISTOR_MIN_TEMP + KELVIN_OFFSET) ? THERMISTOR_MIN_TEMP :
+         1 / inverseKelvin - KELVIN_OFFSET;
+}
+
+template <class TModel>
+constexpr double DegreesFromLnOhms(double lnOhms) {
+  return DegreesFromInverseKelvin(TModel::A + TModel::B * lnOhms + TModel::C * lnOhms * lnOhms * lnOhms);
+}
+
+template <class TModel>
+constexpr double DegreesFromCode(unsigned long code) {
+  return code == 0 ? THERMISTOR_MAX_TEMP :
+         code >= TModel::ADC_FULL_SCALE ? THERMISTOR_MIN_TEMP :
+         DegreesFromLnOhms<TModel>(ConstLn(TModel::PULL_UP_OHMS * code / (TModel::ADC_FULL_SCALE - code)));
+}
+
+constexpr TTemp RoundToTemp(double degrees) {
+  return (TTemp)(degrees * TEMP_SCALE + (degrees < 0 ? -0.5 : 0.5));
+}
+
+template <class TModel>
+constexpr TTemp TableEntry(unsigned long index) {
+  return RoundToTemp(DegreesFromCode<TModel>(index << (TModel::CODE_BITS - TModel::TABLE_BITS)));
+}
+
+//index pack 0..N-1 for the table initializer
+template <unsigned int... I> struct STableIndices {};
+template <unsigned int N, unsigned int... I> struct SMakeTableIndices: SMakeTableIndices<N - 1, N - 1, I...> {};
+template <unsigned int... I> struct SMakeTableIndices<0, I...> { typedef STableIndices<I...> TIndices; };
+
+template <class TModel, class TIndices = typename SMakeTableIndices<(1 << TModel::TABLE_BITS) + 1>::TIndices>
+struct SThermistorTable;
+
+template <class TModel, unsigned int... I>
+struct SThermistorTable<TModel, STableIndices<I...> > {
+  static const TTemp TABLE[sizeof...(I)];
+};
+
+template <class TModel, unsigned int... I>
+const TTemp SThermistorTable<TModel, STableIndices<I...> >::TABLE[sizeof...(I)] PROGMEM = { TableEntry<TModel>(I)... };
+
+//interpolates between the two entries around code, rounding to the nearest TEMP_SCALE unit;
+//codes past CODE_BITS read as the last entry
+template <class TModel>
+TTemp LookupTemp(unsigned long code) {
+  const uint8_t shift = TModel::CODE_BITS - TModel::TABLE_BITS;
+  if (code > (1UL << TModel::CODE_BITS) - 1)
+    code = (1UL << TModel::CODE_BITS) - 1;
+  unsigned int i = code >> shift;
+  long fraction = code & ((1UL << shift) - 1);
+  
+  TTemp low = pgm_read_word_near(SThermistorTable<TModel>::TABLE + i);
+  TTemp high = pgm_read_word_near(SThermistorTable<TModel>::TABLE + i + 1);
+  return low + (((high - low) * fraction + (1L << (shift - 1))) >> shift);
+}
+
+#endif
@@ -78,21 +78,21 @@ const SPIDTuning LID_PID_GAIN_SCHEDULE[] = {
 
 //public
 Thermocycler::Thermocycler(boolean restarted):
-  iRestarted(restarted),
   ipDisplay(NULL),
-  ipProgram(NULL),
-  ipDisplayCycle(NULL),
   ipSerialControl(NULL),
   iProgramState(EStartup),
+  iTargetLidTemp(0),
+  ipProgram(NULL),
+  ipDisplayCycle(NULL),
   ipPreviousStep(NULL),
   ipCurrentStep(NULL),
-  iThermalDirection(OFF),
-  iPeltierPwm(0),
   iCycleStartTime(0),
   iRamping(true),
+  iRestarted(restarted),
   iPlatePid(&iPlateThermistor.GetTemp(), &iPeltierPwm, &iTargetPlateTemp, PLATE_PID_INC_NORM_P, PLATE_PID_INC_NORM_I, PLATE_PID_INC_NORM_D, DIRECT),
   iLidPid(LID_PID_GAIN_SCHEDULE, MIN_LID_PWM, MAX_LID_PWM),
-  iTargetLidTemp(0) {
+  iThermalDirection(OFF),
+  iPeltierPwm(0) {
     
   ipDisplay = new Display();
   ipSerialControl = new SerialControl(ipDisplay);
@@ -111,6 +111,7 @@ Thermocycler::Thermocycler(boolean restarted):
   SPCR = (1<<SPE)|(1<<MSTR)|(1<<4);
   clr=SPSR;
   clr=SPDR;
+  (void)clr; //read only to clear the flags
   delay(10); 
 
   iPlatePid.SetOutputLimits(MIN_PELTIER_PWM, MAX_PELTIER_PWM);
@@ -254,6 +255,11 @@ void Thermocycler::Loop() {
     if (iRamping && ipCurrentStep != NULL && abs(ipCurrentStep->GetTemp() - GetPlateTemp()) <= CYCLE_START_TOLERANCE)
       iRamping = false;
     break;
+    
+  case EStopped:
+  case EError:
+  case EClear:
+    break;
   }
   
   //lid 
@@ -89,7 +89,7 @@ void operator delete(void * ptr) {
 void __cxa_pure_virtual(void) {};
 
 unsigned short htons(unsigned short val) {
-  return val << 8 + (byte)val;
+  return (val << 8) | (val >> 8);
 }
 
 double absf(double val) {
@@ -0,0 +1,200 @@
+/*
+ *  autotune.cpp - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pcr_includes.h"
+#include "pid.h"
+#include "autotune.h"
+
+//the first cycle approaches the setpoint at full drive, the second estimates the holding
+//drive and each further one refines it, running the relay around the last estimate
+#define AUTOTUNE_SETTLE_CYCLES 5
+//after one cycle around the final holding drive
+#define AUTOTUNE_MEASURE_CYCLES 4
+#define AUTOTUNE_RELAY_PWM 400
+#define AUTOTUNE_HYSTERESIS TEMP_C(0.1)
+#define AUTOTUNE_BAND_TIMEOUT_TICKS (unsigned int)(600 * 1000000L / CONTROL_TICK_US)
+#define AUTOTUNE_TEMP_MIN TEMP_C(-300)
+#define AUTOTUNE_TEMP_MAX TEMP_C(300)
+
+//PID from the ultimate gain and period of the thermistor loop. The PID runs on the
+//plate estimate, which leads the thermistor, so it takes more proportional gain than
+//the Tyreus-Luyben 45% with the same slow integral; derivative on the estimate
+//limit cycles at the tick rate, so it stays small
+#define AUTOTUNE_KP_PERCENT 150
+#define AUTOTUNE_TI_PERCENT 220
+#define AUTOTUNE_TD_PERCENT 1
+
+////////////////////////////////////////////////////////////////////
+// Class CPlateAutotune
+CPlateAutotune::CPlateAutotune(int minOutput, int maxOutput):
+  iMinOutput(minOutput),
+  iMaxOutput(maxOutput),
+  ipSchedule(NULL),
+  iState(EDone),
+  iStatus(ESuccess) {
+}
+//------------------------------------------------------------------------------
+TTemp CPlateAutotune::GetTargetTemp() {
+  //the relay runs at each schedule point
+  return ipSchedule->heating[iBand].temp;
+}
+//------------------------------------------------------------------------------
+void CPlateAutotune::Start(SPlateGainSchedule* pSchedule) {
+  ipSchedule = pSchedule;
+  iStatus = ESuccess;
+  BeginBand(0);
+}
+//------------------------------------------------------------------------------
+boolean CPlateAutotune::IsValidSchedule(const SPlateGainSchedule& schedule) {
+  //gains the controller can run with, at temperatures in ascending order
+  for (uint8_t i = 0; i < PLATE_GAIN_BANDS; i++) {
+    if (!CPIDController::IsValidTuning(schedule.heating[i]) || !CPIDController::IsValidTuning(schedule.cooling[i]))
+      return false;
+    if (i > 0 && (schedule.heating[i].temp <= schedule.heating[i - 1].temp ||
+                  schedule.cooling[i].temp <= schedule.cooling[i - 1].temp))
+      return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+int CPlateAutotune::Compute(TTemp temp) {
+  if (iState == EDone)
+    return 0;
+  if (++iBandTicks > AUTOTUNE_BAND_TIMEOUT_TICKS) {
+    //the block never oscillated around the setpoint
+    Finish(EAutotuneFailed);
+    return 0;
+  }
+  
+  if (temp > iMaxTemp)
+    iMaxTemp = temp;
+  if (temp < iMinTemp)
+    iMinTemp = temp;
+  
+  //relay with hysteresis, a cycle ends when it switches back to heating
+  TTemp target = GetTargetTemp();
+  if (iHeating && temp > target + AUTOTUNE_HYSTERESIS) {
+    iHeating = false;
+  } else if (!iHeating && temp < target - AUTOTUNE_HYSTERESIS) {
+    iHeating = true;
+    EndCycle();
+    if (iState == EDone)
+      return 0;
+  }
+  
+  if (iHeating)
+    iHeatingTicks++;
+  else
+    iCoolingTicks++;
+  int drive = constrain(iHeating ? iBias + iAmplitude : iBias - iAmplitude, iMinOutput, iMaxOutput);
+  iDriveSum += drive;
+  return drive;
+}
+//------------------------------------------------------------------------------
+void CPlateAutotune::BeginBand(uint8_t band) {
+  iBand = band;
+  iState = ESettling;
+  iCycle = 0;
+  iBandTicks = 0;
+  
+  //starts heating, the first tick above the setpoint turns it round
+  iHeating = true;
+  iBias = 0;
+  iAmplitude = iMaxOutput > -iMinOutput ? iMaxOutput : -iMinOutput;
+  
+  iHeatingTicks = iCoolingTicks = 0;
+  iDriveSum = 0;
+  iMaxTemp = AUTOTUNE_TEMP_MIN;
+  iMinTemp = AUTOTUNE_TEMP_MAX;
+}
+//------------------------------------------------------------------------------
+void CPlateAutotune::EndCycle() {
+  if (iState == ESettling) {
+    if (iCycle > 0) {
+      //the mean drive over a whole cycle holds the block at the setpoint; at full drive
+      //Joule heating makes it a rough estimate, the smaller relay refines it
+      iBias = iDriveSum / (long)(iHeatingTicks + iCoolingTicks);
+      iAmplitude = AUTOTUNE_RELAY_PWM;
+    }
+    if (iCycle + 1 == AUTOTUNE_SETTLE_CYCLES) {
+      iState = EMeasuring;
+      iTotalHeatingTicks = iTotalCoolingTicks = 0;
+      iTotalPeakToPeak = 0;
+    }
+  } else if (iCycle > AUTOTUNE_SETTLE_CYCLES) {
+    iTotalHeatingTicks += iHeatingTicks;
+    iTotalCoolingTicks += iCoolingTicks;
+    iTotalPeakToPeak += iMaxTemp - iMinTemp;
+    
+    if (iCycle == AUTOTUNE_SETTLE_CYCLES + AUTOTUNE_MEASURE_CYCLES) {
+      CalculateGains();
+      if (iState == EDone)
+        return;
+      if (iBand + 1 < PLATE_GAIN_BANDS)
+        BeginBand(iBand + 1);
+      else
+        Finish(ESuccess);
+      return;
+    }
+  }
+  
+  iCycle++;
+  iHeatingTicks = iCoolingTicks = 0;
+  iDriveSum = 0;
+  iMaxTemp = AUTOTUNE_TEMP_MIN;
+  iMinTemp = AUTOTUNE_TEMP_MAX;
+}
+//------------------------------------------------------------------------------
+void CPlateAutotune::CalculateGains() {
+  //relay half swing, less where the drive limits clip it
+  long relay = (constrain(iBias + iAmplitude, iMinOutput, iMaxOutput) - constrain(iBias - iAmplitude, iMinOutput, iMaxOutput)) / 2;
+  long amplitude = iTotalPeakToPeak / (2 * AUTOTUNE_MEASURE_CYCLES);
+  if (amplitude <= 0 || relay <= 0 || iTotalHeatingTicks == 0 || iTotalCoolingTicks == 0) {
+    Finish(EAutotuneFailed);
+    return;
+  }
+  
+  //ultimate gain 4d / (pi a) in PWM counts per degree, pi as 355 / 113
+  long ultimateGain = 4 * relay * TEMP_SCALE * 113 / (355 * amplitude);
+  long kP = ultimateGain * PID_GAIN_SCALE * AUTOTUNE_KP_PERCENT / 100;
+  
+  //the ultimate period of each direction, from the half cycle it drove
+  long periodMs[2] = {
+    2L * iTotalHeatingTicks * (CONTROL_TICK_US / 1000) / AUTOTUNE_MEASURE_CYCLES,
+    2L * iTotalCoolingTicks * (CONTROL_TICK_US / 1000) / AUTOTUNE_MEASURE_CYCLES
+  };
+  SPIDTuning tunings[2] = { ipSchedule->heating[iBand], ipSchedule->cooling[iBand] };
+  for (uint8_t i = 0; i < 2; i++) {
+    long integralMs = periodMs[i] * AUTOTUNE_TI_PERCENT / 100;
+    tunings[i].kP = kP;
+    tunings[i].kI = kP * 1000 / (integralMs > 0 ? integralMs : 1);
+    tunings[i].kD = kP * AUTOTUNE_TD_PERCENT / 100 * periodMs[i] / 1000;
+    
+    //gains the controller cannot run with fail the band rather than being clamped
+    if (!CPIDController::IsValidTuning(tunings[i])) {
+      Finish(EAutotuneFailed);
+      return;
+    }
+  }
+  ipSchedule->heating[iBand] = tunings[0];
+  ipSchedule->cooling[iBand] = tunings[1];
+}
+//------------------------------------------------------------------------------
+void CPlateAutotune::Finish(PcrStatus status) {
+  iStatus = status;
+  iState = EDone;
+}
@@ -0,0 +1,91 @@
+/*
+ *  autotune.h - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _AUTOTUNE_H_
+#define _AUTOTUNE_H_
+
+//plate gain schedule points, low, normal and high temperatures, each tuned with the
+//relay at its temperature and interpolated between
+#define PLATE_GAIN_BANDS 3
+
+//one schedule per direction, as the Peltier heats and cools the block differently
+struct SPlateGainSchedule {
+  SPIDTuning heating[PLATE_GAIN_BANDS];
+  SPIDTuning cooling[PLATE_GAIN_BANDS];
+};
+
+////////////////////////////////////////////////////////////////////
+// Class CPlateAutotune
+//Relay (Astrom-Hagglund) experiments on the plate. In each band the plate thermistor
+//is driven into a limit cycle around the setpoint by switching the Peltier between two levels
+//either side of the drive that holds it there. The amplitude gives the ultimate gain,
+//the time spent heating and cooling the ultimate period of each direction, and the
+//gains of that band follow from them.
+class CPlateAutotune {
+public:
+  CPlateAutotune(int minOutput, int maxOutput);
+  
+  //accessors
+  boolean Running() { return iState != EDone; }
+  PcrStatus GetStatus() { return iStatus; }
+  TTemp GetTargetTemp();
+  
+  //tuning, writes the gains of each band into the schedule as it completes
+  void Start(SPlateGainSchedule* pSchedule);
+  static boolean IsValidSchedule(const SPlateGainSchedule& schedule); //e.g. one read back from EEPROM
+  int Compute(TTemp temp); //once per control tick with the thermistor, returns the Peltier drive
+  
+private:
+  enum TState {
+    ESettling = 0, //finds the holding drive
+    EMeasuring,    //relay around the holding drive
+    EDone
+  };
+  
+  void BeginBand(uint8_t band);
+  void EndCycle();
+  void CalculateGains();
+  void Finish(PcrStatus status);
+  
+private:
+  int iMinOutput, iMaxOutput;
+  SPlateGainSchedule* ipSchedule;
+  TState iState;
+  PcrStatus iStatus;
+  uint8_t iBand;
+  uint8_t iCycle;
+  unsigned int iBandTicks;
+  
+  //relay
+  boolean iHeating;
+  int iBias;
+  int iAmplitude;
+  
+  //current cycle
+  unsigned int iHeatingTicks;
+  unsigned int iCoolingTicks;
+  long iDriveSum; //drive times ticks, for the holding drive
+  TTemp iMaxTemp;
+  TTemp iMinTemp;
+  
+  //measured cycles
+  unsigned int iTotalHeatingTicks;
+  unsigned int iTotalCoolingTicks;
+  long iTotalPeakToPeak;
+};
+
+#endif
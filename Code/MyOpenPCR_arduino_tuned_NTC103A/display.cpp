@@ -29,7 +29,9 @@
 const char HEATING_STR[] PROGMEM = "Heating";
 const char COOLING_STR[] PROGMEM = "Cooling";
 const char LIDWAIT_STR[] PROGMEM = "Heating Lid";
+const char AUTOTUNE_STR[] PROGMEM = "Autotuning";
 const char STOPPED_STR[] PROGMEM = "Ready";
+const char ERROR_STR[] PROGMEM = "Error";
 const char RUN_COMPLETE_STR[] PROGMEM = "*** Run Complete ***";
 const char OPENPCR_STR[] PROGMEM = "OpenPCR";
 const char POWERED_OFF_STR[] PROGMEM = "Powered Off";
@@ -42,6 +44,7 @@ const char ETA_SEC_FORM_STR[] PROGMEM = "ETA:  %2ds";
 const char BLOCK_TEMP_FORM_STR[] PROGMEM = "%s C";
 const char STATE_FORM_STR[] PROGMEM = "%-13s";
 const char VERSION_FORM_STR[] PROGMEM = "Firmware v%s";
+const char ERROR_FORM_STR[] PROGMEM = "Error code %d";
 
 Display::Display():
   iLcd(6, 7, 8, A5, 16, 17),
@@ -95,6 +98,7 @@ void Display::Update() {
   case Thermocycler::EComplete:
   case Thermocycler::ELidWait:
   case Thermocycler::EStopped:
+  case Thermocycler::EError:
     iLcd.setCursor(0, 1);
  #ifdef DEBUG_DISPLAY
     iLcd.print(iszDebugMsg);
@@ -112,9 +116,18 @@ void Display::Update() {
     } else if (state == Thermocycler::EComplete) {
       iLcd.setCursor(0, 3);
       iLcd.print(rps(RUN_COMPLETE_STR));
+    } else if (state == Thermocycler::EError) {
+      iLcd.setCursor(0, 3);
+      sprintf_P(buf, ERROR_FORM_STR, GetThermocycler().GetErrorStatus());
+      iLcd.print(buf);
     }
     break;
   
+  case Thermocycler::EAutotune:
+    DisplayBlockTemp();
+    DisplayState();
+    break;
+    
   case Thermocycler::EStartup:
     iLcd.setCursor(6, 1);
     iLcd.print(rps(OPENPCR_STR));
@@ -123,11 +136,14 @@ void Display::Update() {
       sprintf_P(buf, VERSION_FORM_STR, OPENPCR_FIRMWARE_VERSION_STRING);
       iLcd.print(buf);
     break;
+    
+  case Thermocycler::EClear:
+    break;
   }
 }
 
 void Display::DisplayEta() {
-  char timeString[16];
+  char timeString[24];
   unsigned long timeRemaining = GetThermocycler().GetTimeRemainingS();
   int hours = timeRemaining / 3600;
   int mins = (timeRemaining % 3600) / 60;
@@ -146,18 +162,18 @@ void Display::DisplayEta() {
 
 void Display::DisplayLidTemp() {
   char buf[16];
-  sprintf_P(buf, LID_FORM_STR, (int)(GetThermocycler().GetLidTemp() + 0.5));
+  sprintf_P(buf, LID_FORM_STR, (GetThermocycler().GetLidTemp() + TEMP_SCALE / 2) / TEMP_SCALE);
 
   iLcd.setCursor(10, 2);
   iLcd.print(buf);
 }
 
 void Display::DisplayBlockTemp() {
-  char buf[16];
-  char floatStr[16];
+  char buf[20];
+  char tempStr[16];
   
-  sprintFloat(floatStr, GetThermocycler().GetPlateTemp(), 1, true);
-  sprintf_P(buf, BLOCK_TEMP_FORM_STR, floatStr);
+  sprintTemp(tempStr, GetThermocycler().GetPlateTemp(), true);
+  sprintf_P(buf, BLOCK_TEMP_FORM_STR, tempStr);
  
   iLcd.setCursor(13, 0);
   iLcd.print(buf);
@@ -193,6 +209,7 @@ void Display::DisplayState() {
       stateStr = GetThermocycler().GetCurrentStep()->GetName();
       break;
     case Thermocycler::EIdle:
+    default:
       stateStr = rps(STOPPED_STR);
       break;
     }
@@ -201,6 +218,17 @@ void Display::DisplayState() {
   case Thermocycler::EStopped:
     stateStr = rps(STOPPED_STR);
     break;
+    
+  case Thermocycler::EAutotune:
+    stateStr = rps(AUTOTUNE_STR);
+    break;
+    
+  case Thermocycler::EError:
+    stateStr = rps(ERROR_STR);
+    break;
+    
+  default:
+    return; //no state line
   }
   
   iLcd.setCursor(0, 0);
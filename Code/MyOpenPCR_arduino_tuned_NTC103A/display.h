@@ -22,7 +22,7 @@
 #include <LiquidCrystal.h>
 #include "thermocycler.h"
 
-class Cycle;
+class Program;
 
 class Display {
 public:
@@ -0,0 +1,108 @@
+/*
+ *  estimator.cpp - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pcr_includes.h"
+#include "estimator.h"
+
+//plant, identified on the host build's lumped block model; re-identify for other blocks
+#define ESTIMATOR_SENSOR_TAU_S 1.5  //plate thermistor lag behind the block
+#define ESTIMATOR_FULL_PWM 1023
+
+//per tick model steps, in 1/256
+#define ESTIMATOR_GAIN_BITS 8
+#define ESTIMATOR_TICK_S (CONTROL_TICK_US / 1000000.0)
+#define ESTIMATOR_DRIVE_STEP ((long)(PLATE_DRIVE_RATE * ESTIMATOR_TICK_S * TEMP_SCALE * (1L << ESTIMATOR_FRACTION_BITS) + 0.5))
+#define ESTIMATOR_SENSOR_STEP ((long)(ESTIMATOR_TICK_S / ESTIMATOR_SENSOR_TAU_S * (1 << ESTIMATOR_GAIN_BITS) + 0.5))
+
+//sample lag in a 0.2 mL tube: tube wall and liquid heat capacity against a conductance
+//to the block that grows with the wetted depth, 4.5 s for 20 uL
+#define ESTIMATOR_DEFAULT_SAMPLE_UL 20
+#define ESTIMATOR_MAX_SAMPLE_UL 200
+#define ESTIMATOR_SAMPLE_TAU_MS 8340 //large sample limit
+#define ESTIMATOR_TUBE_UL 12         //tube wall heat capacity, as uL of water
+#define ESTIMATOR_WETTED_UL 40       //sample that doubles the conductance
+
+//observer gains in 1/256, error poles at 1.5, 2 and 2.5 rad/s for the 164 ms tick
+#define ESTIMATOR_BLOCK_GAIN 486
+#define ESTIMATOR_SENSOR_GAIN 148
+#define ESTIMATOR_DISTURBANCE_GAIN 48
+
+//a larger jump is a glitch or a restart, so the estimate starts over from the sensor
+#define ESTIMATOR_MAX_INNOVATION TEMP_C(10)
+
+////////////////////////////////////////////////////////////////////
+// Class CPlateEstimator
+CPlateEstimator::CPlateEstimator():
+  iInitialized(false),
+  iBlock(0),
+  iSensor(0),
+  iSample(0),
+  iSampleStep(0),
+  iDisturbance(0),
+  iBlockTemp(0) {
+  SetSampleVolume(ESTIMATOR_DEFAULT_SAMPLE_UL);
+}
+//------------------------------------------------------------------------------
+TTemp CPlateEstimator::GetSampleTemp() {
+  return (iSample + (1L << (ESTIMATOR_FRACTION_BITS - 1))) >> ESTIMATOR_FRACTION_BITS;
+}
+//------------------------------------------------------------------------------
+void CPlateEstimator::SetSampleVolume(int volumeUl) {
+  if (volumeUl <= 0)
+    volumeUl = ESTIMATOR_DEFAULT_SAMPLE_UL;
+  else if (volumeUl > ESTIMATOR_MAX_SAMPLE_UL)
+    volumeUl = ESTIMATOR_MAX_SAMPLE_UL;
+  
+  long tauMs = (long)ESTIMATOR_SAMPLE_TAU_MS * (volumeUl + ESTIMATOR_TUBE_UL) / (volumeUl + ESTIMATOR_WETTED_UL);
+  iSampleStep = (CONTROL_TICK_US << ESTIMATOR_SAMPLE_BITS) / (tauMs * 1000);
+}
+//------------------------------------------------------------------------------
+void CPlateEstimator::Update(int peltierPwm, TTemp measuredTemp, boolean newSample) {
+  if (!iInitialized) {
+    if (newSample)
+      Reset(measuredTemp);
+    return;
+  }
+  
+  //predict: the block follows the drive, sensor and sample follow the block
+  long block = iBlock + (long)peltierPwm * ESTIMATOR_DRIVE_STEP / ESTIMATOR_FULL_PWM + iDisturbance;
+  iSensor += ((iBlock - iSensor) * ESTIMATOR_SENSOR_STEP) >> ESTIMATOR_GAIN_BITS;
+  iSample += ((iBlock - iSample) * iSampleStep) >> ESTIMATOR_SAMPLE_BITS;
+  iBlock = block;
+  
+  //correct with the measurement, when the converter delivered one
+  if (newSample) {
+    long innovation = (long)measuredTemp * (1L << ESTIMATOR_FRACTION_BITS) - iSensor;
+    if (abs(innovation) > ((long)ESTIMATOR_MAX_INNOVATION << ESTIMATOR_FRACTION_BITS)) {
+      Reset(measuredTemp);
+      return;
+    }
+    iBlock += (innovation * ESTIMATOR_BLOCK_GAIN) >> ESTIMATOR_GAIN_BITS;
+    iSensor += (innovation * ESTIMATOR_SENSOR_GAIN) >> ESTIMATOR_GAIN_BITS;
+    iDisturbance += (innovation * ESTIMATOR_DISTURBANCE_GAIN) >> ESTIMATOR_GAIN_BITS;
+  }
+  
+  iBlockTemp = (iBlock + (1L << (ESTIMATOR_FRACTION_BITS - 1))) >> ESTIMATOR_FRACTION_BITS;
+}
+//------------------------------------------------------------------------------
+void CPlateEstimator::Reset(TTemp measuredTemp) {
+  //an open or shorted thermistor reads below zero, so this multiplies rather than shifts
+  iBlock = iSensor = iSample = (long)measuredTemp * (1L << ESTIMATOR_FRACTION_BITS);
+  iDisturbance = 0;
+  iBlockTemp = measuredTemp;
+  iInitialized = true;
+}
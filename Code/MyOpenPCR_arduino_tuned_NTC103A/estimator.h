@@ -0,0 +1,61 @@
+/*
+ *  estimator.h - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ESTIMATOR_H_
+#define _ESTIMATOR_H_
+
+//state is kept in TEMP_SCALE units with ESTIMATOR_FRACTION_BITS below them, so the
+//small per tick corrections are not lost
+#define ESTIMATOR_FRACTION_BITS 8
+//the sample follows the block by a small share per tick, kept with this many bits
+#define ESTIMATOR_SAMPLE_BITS 12
+
+////////////////////////////////////////////////////////////////////
+// Class CPlateEstimator
+//Observer for the block behind the lagging plate thermistor. Predicts block, sensor
+//and sample temperature from the Peltier drive, then corrects the prediction with
+//the measured sensor temperature. An integrated disturbance absorbs what the simple
+//drive model leaves out: losses, heat sink temperature and Peltier efficiency.
+class CPlateEstimator {
+public:
+  CPlateEstimator();
+  
+  //accessors
+  TTemp& GetBlockTemp() { return iBlockTemp; }
+  TTemp GetSampleTemp();
+  unsigned int GetSampleLagTicks() { return (1L << ESTIMATOR_SAMPLE_BITS) / iSampleStep; } //sample time constant
+  
+  //configuration
+  void SetSampleVolume(int volumeUl); //uL in each tube, 0 for the default
+  
+  //estimation, once per control tick with the drive applied since the last one
+  void Update(int peltierPwm, TTemp measuredTemp, boolean newSample);
+  
+private:
+  void Reset(TTemp measuredTemp);
+  
+private:
+  boolean iInitialized;
+  long iBlock;
+  long iSensor;
+  long iSample;
+  long iSampleStep;  //sample share of the block difference per tick, ESTIMATOR_SAMPLE_BITS
+  long iDisturbance; //block temperature change per tick not explained by the drive
+  TTemp iBlockTemp;  //published for the plate PID
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ *  learning.cpp - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pcr_includes.h"
+#include "learning.h"
+
+//feedforward correction per iteration: PWM counts per degree C of mean bin error
+#define ILC_GAIN 250
+#define ILC_FEEDFORWARD_SCALE 8
+//the block answers the drive a few seconds later, so each bin learns from the error that far ahead
+#define ILC_LEAD_BINS 4
+#define ILC_MAX_ERROR TEMP_C(5)
+
+////////////////////////////////////////////////////////////////////
+// Class CIterativeLearning
+CIterativeLearning::CIterativeLearning(int minOutput, int maxOutput):
+  iMinOutput(minOutput),
+  iMaxOutput(maxOutput) {
+  Reset();
+}
+//------------------------------------------------------------------------------
+void CIterativeLearning::Reset() {
+  iNumTransitions = 0;
+  iNextReplaced = 0;
+  ipActive = NULL;
+}
+//------------------------------------------------------------------------------
+void CIterativeLearning::BeginTransition(Step* pFromStep, Step* pToStep) {
+  EndTransition();
+  
+  ipActive = FindTransition(pFromStep, pToStep);
+  iTick = 0;
+  memset(iBinErrors, 0, sizeof(iBinErrors));
+}
+//------------------------------------------------------------------------------
+void CIterativeLearning::EndTransition() {
+  if (ipActive == NULL)
+    return;
+  
+  Learn();
+  ipActive = NULL;
+}
+//------------------------------------------------------------------------------
+int CIterativeLearning::Apply(int output, TTemp error) {
+  if (ipActive == NULL)
+    return output;
+  
+  uint8_t bin = iTick / ILC_TICKS_PER_BIN;
+  if (bin >= ILC_BINS) {
+    EndTransition();
+    return output;
+  }
+  
+  iBinErrors[bin] += constrain(error, -ILC_MAX_ERROR, ILC_MAX_ERROR);
+  iTick++;
+  
+  return constrain(output + ipActive->feedforward[bin] * ILC_FEEDFORWARD_SCALE, iMinOutput, iMaxOutput);
+}
+//------------------------------------------------------------------------------
+SLearnedTransition* CIterativeLearning::FindTransition(Step* pFromStep, Step* pToStep) {
+  for (uint8_t i = 0; i < iNumTransitions; i++) {
+    if (iTransitions[i].pFromStep == pFromStep && iTransitions[i].pToStep == pToStep)
+      return &iTransitions[i];
+  }
+  
+  //not seen yet: take a free slot, or replace the oldest
+  SLearnedTransition* pTransition;
+  if (iNumTransitions < ILC_MAX_TRANSITIONS) {
+    pTransition = &iTransitions[iNumTransitions++];
+  } else {
+    pTransition = &iTransitions[iNextReplaced];
+    iNextReplaced = (iNextReplaced + 1) % ILC_MAX_TRANSITIONS;
+  }
+  pTransition->pFromStep = pFromStep;
+  pTransition->pToStep = pToStep;
+  memset(pTransition->feedforward, 0, sizeof(pTransition->feedforward));
+  return pTransition;
+}
+//------------------------------------------------------------------------------
+void CIterativeLearning::Learn() {
+  //bins the window did not reach have no error and keep their feedforward
+  const long correctionScale = (long)ILC_TICKS_PER_BIN * TEMP_SCALE * ILC_FEEDFORWARD_SCALE;
+  for (uint8_t i = 0; i < ILC_BINS; i++) {
+    int errorSum = iBinErrors[i + ILC_LEAD_BINS < ILC_BINS ? i + ILC_LEAD_BINS : ILC_BINS - 1];
+    long feedforward = ipActive->feedforward[i] + (long)errorSum * ILC_GAIN / correctionScale;
+    ipActive->feedforward[i] = constrain(feedforward, -127, 127);
+  }
+}
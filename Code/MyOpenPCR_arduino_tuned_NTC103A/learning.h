@@ -0,0 +1,66 @@
+/*
+ *  learning.h - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LEARNING_H_
+#define _LEARNING_H_
+
+class Step;
+
+//the window after the PID takes over near a new target, 20 bins of 4 control ticks (~13 s),
+//long enough to cover the ~10 s a heavy block takes to settle
+#define ILC_BINS 20
+#define ILC_TICKS_PER_BIN 4
+#define ILC_MAX_TRANSITIONS 6 //distinct step transitions remembered, enough for a 6 step cycle
+
+struct SLearnedTransition {
+  Step* pFromStep;
+  Step* pToStep;
+  int8_t feedforward[ILC_BINS]; //in ILC_FEEDFORWARD_SCALE PWM counts
+};
+
+////////////////////////////////////////////////////////////////////
+// Class CIterativeLearning
+//Feedforward learned across the iterations of a cycle. Each time the same step
+//transition settles, the tracking error of every bin corrects the feedforward that
+//the next iteration adds to the PID output in that bin.
+class CIterativeLearning {
+public:
+  CIterativeLearning(int minOutput, int maxOutput);
+  
+  //transitions
+  void Reset(); //forgets everything learned, for a new program
+  void BeginTransition(Step* pFromStep, Step* pToStep);
+  void EndTransition();
+  
+  //computation, once per control tick while the PID runs
+  int Apply(int output, TTemp error);
+  
+private:
+  SLearnedTransition* FindTransition(Step* pFromStep, Step* pToStep);
+  void Learn();
+  
+private:
+  int iMinOutput, iMaxOutput;
+  SLearnedTransition iTransitions[ILC_MAX_TRANSITIONS];
+  uint8_t iNumTransitions;
+  uint8_t iNextReplaced;
+  SLearnedTransition* ipActive;
+  uint8_t iTick;
+  int iBinErrors[ILC_BINS]; //sum of the tracking error over each bin, in TEMP_SCALE units
+};
+
+#endif
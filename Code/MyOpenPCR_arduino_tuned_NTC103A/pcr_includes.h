@@ -20,6 +20,7 @@
 #define _PCR_INCLUDES_H_
 
 //#define DEBUG_DISPLAY
+//#define PLATE_ADC_MCP342X //plate thermistor on an MCP3422/3424 over I2C instead of the SPI LTC2400
 #define OPENPCR_FIRMWARE_VERSION_STRING "1.0.5"
 #define PLATE_FAST_RAMP_THRESHOLD_MS 1000
 
@@ -37,21 +38,35 @@ extern "C" void __cxa_pure_virtual(void);
 
 //defines
 #define STEP_NAME_LENGTH       14
-#define MAX_CYCLE_ITEMS        16
 #define MAX_COMMAND_SIZE      256
 
 enum PcrStatus {
   ESuccess = 0,
   ETooManySteps = 32,
   ENoProgram,
-  ENoPower
+  ENoPower,
+  EAutotuneFailed,
+  EBadProgram
 };
 
 #define SUCCEEDED(status) (status == ESuccess)
 
-void sprintFloat(char* str, float val, int decimalDigits, boolean pad);
+//Timer1 overflows every 1.023 ms (10 bit phase correct PWM, clk/8), so the
+//control path runs every ~164 ms, about one plate ADC conversion
+#define CONTROL_TICK_OVERFLOWS 160
+#define CONTROL_TICK_US (CONTROL_TICK_OVERFLOWS * 1023L)
+
+//block C/s at full Peltier PWM, heating or cooling, identified on the host build's lumped
+//block model; the estimator's plant and the trajectory's rate until the ramps measure it
+#define PLATE_DRIVE_RATE 1.8
+
+//temperatures are fixed point hundredths of a degree C from the ADC to the PWM
+typedef int16_t TTemp;
+#define TEMP_SCALE 100
+#define TEMP_C(degrees) ((TTemp)((degrees) * TEMP_SCALE))
+
+void sprintTemp(char* str, TTemp temp, boolean pad);
 unsigned short htons(unsigned short val);
-double absf(double val);
 char* rps(const char* progString);
 
 #endif
@@ -19,58 +19,144 @@
 #include "pcr_includes.h"
 #include "pid.h"
 
+//larger errors saturate any useful gain; the limit keeps kP * error within 32 bits
+//for kP up to PID_MAX_KP
+#define PID_MAX_ERROR TEMP_C(20)
+#define PID_MAX_RATE TEMP_C(2) //per sample, well above any block ramp
+//derivative low pass, the rate moves 1/2^n of the way to each new sample
+#define PID_RATE_FILTER_BITS 2
+//back calculation, each sample winds the integrator back by 1/2^n of the saturation,
+//which tracks over about the integral time of the plate gains
+#define PID_ANTIWINDUP_BITS 6
+#define PID_INTERPOLATION_BITS 8
+//integrator resolution below the output scale, small kI lose little to rounding per sample
+#define PID_INTEGRATOR_FRACTION_BITS 5
+
 ////////////////////////////////////////////////////////////////////
 // Class CPIDController
-CPIDController::CPIDController(const SPIDTuning* pGainSchedule, int minOutput, int maxOutput):
-  ipGainSchedule(pGainSchedule),
+CPIDController::CPIDController(const SPIDTuning* pHeatingSchedule, const SPIDTuning* pCoolingSchedule, uint8_t numPoints,
+                               int minOutput, int maxOutput, unsigned long sampleUs):
+  ipHeatingSchedule(pHeatingSchedule),
+  ipCoolingSchedule(pCoolingSchedule),
+  iNumPoints(numPoints),
   iMinOutput(minOutput),
   iMaxOutput(maxOutput),
+  iSampleUs(sampleUs),
+  iCooling(false),
+  iGainsValid(false),
+  iGainTarget(0),
+  iKp(0),
+  iKiSample(0),
+  iKdSample(0),
   iIntegrator(0),
-  iPreviousError(0) {
+  iPreviousValue(0),
+  iRate(0),
+  iStarted(false) {
+}
+//------------------------------------------------------------------------------
+boolean CPIDController::IsValidTuning(const SPIDTuning& tuning) {
+  return tuning.kP >= 0 && tuning.kP <= PID_MAX_KP && tuning.kI >= 0 && tuning.kI <= PID_MAX_KI &&
+         tuning.kD >= 0 && tuning.kD <= PID_MAX_KD;
+}
+//------------------------------------------------------------------------------
+void CPIDController::SetGainSchedule(const SPIDTuning* pHeatingSchedule, const SPIDTuning* pCoolingSchedule) {
+  ipHeatingSchedule = pHeatingSchedule;
+  ipCoolingSchedule = pCoolingSchedule;
+  iGainsValid = false;
+}
+//------------------------------------------------------------------------------
+void CPIDController::SetCooling(boolean cooling) {
+  if (cooling != iCooling) {
+    iCooling = cooling;
+    iGainsValid = false;
+  }
 }
 //------------------------------------------------------------------------------
-double CPIDController::Compute(double target, double currentValue) {
-  //calc values for this computation
-  const SPIDTuning* pPIDTuning = DetermineGainSchedule(target);
-  double error = target - currentValue;
+int CPIDController::Compute(TTemp target, TTemp currentValue, long targetRate, int feedforward) {
+  //output is scaled by TEMP_SCALE * PID_GAIN_SCALE until it is returned
+  const long outputScale = (long)TEMP_SCALE * PID_GAIN_SCALE;
   
-  //perform basic PID calculation
-  double pTerm = error;
-  double iTerm = iIntegrator + error;
-  double dTerm = error - iPreviousError;
-  double output = (pPIDTuning->kP * pTerm) + (pPIDTuning->kI * iTerm) + (pPIDTuning->kD * dTerm);  
+  if (!iStarted)
+    Reset(currentValue, 0);
   
-  //reset integrator if pTerm maxed out in drivable direction
-  if ((iMaxOutput && pTerm * pPIDTuning->kP > iMaxOutput) ||
-      (iMinOutput && pTerm * pPIDTuning->kP < iMinOutput)) {
-    iIntegrator = 0;
-    
-  //accumulate integrator if output not maxed out in drivable direction
-  } else if ((iMinOutput == 0 || output > iMinOutput) && 
-             (iMaxOutput == 0 || output < iMaxOutput)) {
-    iIntegrator += error;
-  }
+  long error = constrain(target - currentValue, -PID_MAX_ERROR, PID_MAX_ERROR);
   
-  //latch integrator and output value to controllable range
-  LatchValue(&iIntegrator, iMinOutput, iMaxOutput);
-  LatchValue(&output, iMinOutput, iMaxOutput);
-
-  //update values for next derivative computation
-  iPreviousError = error;
-
-  return output;
+  //derivative on the measurement against the planned rate, so target steps do not kick the output
+  //signed values are scaled by multiplying, a left shift of a negative one is undefined
+  long rate = (long)constrain(currentValue - iPreviousValue, -PID_MAX_RATE, PID_MAX_RATE) * (1L << PID_RATE_FRACTION_BITS);
+  iRate += (rate - iRate + (1 << (PID_RATE_FILTER_BITS - 1))) >> PID_RATE_FILTER_BITS;
+  iPreviousValue = currentValue;
+  long rateError = constrain(targetRate - iRate, -((long)PID_MAX_RATE << PID_RATE_FRACTION_BITS), (long)PID_MAX_RATE << PID_RATE_FRACTION_BITS);
+  
+  if (!iGainsValid || target != iGainTarget)
+    UpdateGains(target, error, rateError);
+  
+  iIntegrator += iKiSample * error;
+  long output = iKp * error + (iIntegrator >> PID_INTEGRATOR_FRACTION_BITS) + ((iKdSample * rateError) >> PID_RATE_FRACTION_BITS) +
+                feedforward * outputScale;
+  
+  //back calculation: what the output could not deliver is taken out of the integrator
+  long latchedOutput = output;
+  LatchValue(&latchedOutput, iMinOutput * outputScale, iMaxOutput * outputScale);
+  AddToIntegrator((latchedOutput - output) >> PID_ANTIWINDUP_BITS);
+  
+  return latchedOutput / outputScale;
 }
 //------------------------------------------------------------------------------
-const SPIDTuning* CPIDController::DetermineGainSchedule(double target) {
-  const SPIDTuning* pGainScheduleItem = ipGainSchedule;
+void CPIDController::Reset(TTemp currentValue, int output) {
+  iIntegrator = (long)output * TEMP_SCALE * PID_GAIN_SCALE * (1L << PID_INTEGRATOR_FRACTION_BITS);
+  iPreviousValue = currentValue;
+  iRate = 0;
+  iStarted = true;
+}
+//------------------------------------------------------------------------------
+void CPIDController::UpdateGains(TTemp target, TTemp error, long rateError) {
+  //the schedule segment holding the target, clamped to the end points
+  const SPIDTuning* pLow = iCooling ? ipCoolingSchedule : ipHeatingSchedule;
+  const SPIDTuning* pLast = pLow + iNumPoints - 1;
+  while (pLow < pLast && target >= (pLow + 1)->temp)
+    pLow++;
+  const SPIDTuning* pHigh = pLow < pLast ? pLow + 1 : pLow;
   
-  while (target > pGainScheduleItem->maxValueInclusive)
-    pGainScheduleItem++;
-    
-  return pGainScheduleItem;
+  long kP = pLow->kP, kI = pLow->kI, kD = pLow->kD;
+  if (pHigh != pLow && target > pLow->temp) {
+    long fraction = ((long)(target - pLow->temp) << PID_INTERPOLATION_BITS) / (pHigh->temp - pLow->temp);
+    kP += ((pHigh->kP - kP) * fraction) >> PID_INTERPOLATION_BITS;
+    kI += ((pHigh->kI - kI) * fraction) >> PID_INTERPOLATION_BITS;
+    kD += ((pHigh->kD - kD) * fraction) >> PID_INTERPOLATION_BITS;
+  }
+  kP = constrain(kP, 0, PID_MAX_KP);
+  kI = constrain(kI, 0, PID_MAX_KI);
+  kD = constrain(kD, 0, PID_MAX_KD);
+  
+  //per sample gains, kI * sample seconds would overflow so whole milliseconds and the
+  //microsecond remainder are scaled separately
+  long kISampleMs = kI * (long)(iSampleUs / 1000) + kI * (long)(iSampleUs % 1000) / 1000;
+  long kISample = ((kISampleMs / 1000) << PID_INTEGRATOR_FRACTION_BITS) +
+                  (((kISampleMs % 1000) << PID_INTEGRATOR_FRACTION_BITS) + 500) / 1000;
+  long kDSample = kD * 10000 / (long)((iSampleUs + 50) / 100);
+  
+  //bumpless: the integrator takes up the change of the proportional and derivative terms
+  if (iGainsValid)
+    AddToIntegrator((iKp - kP) * error + (((iKdSample - kDSample) * rateError) >> PID_RATE_FRACTION_BITS));
+  
+  iKp = kP;
+  iKiSample = kISample;
+  iKdSample = kDSample;
+  iGainTarget = target;
+  iGainsValid = true;
+}
+//------------------------------------------------------------------------------
+void CPIDController::AddToIntegrator(long outputChange) {
+  //anything beyond the output range only latches, and would overflow once shifted
+  long outputRange = (long)(iMaxOutput - iMinOutput) * TEMP_SCALE * PID_GAIN_SCALE;
+  LatchValue(&outputChange, -outputRange, outputRange);
+  iIntegrator += outputChange * (1L << PID_INTEGRATOR_FRACTION_BITS);
+  LatchValue(&iIntegrator, (long)iMinOutput * TEMP_SCALE * PID_GAIN_SCALE * (1L << PID_INTEGRATOR_FRACTION_BITS),
+             (long)iMaxOutput * TEMP_SCALE * PID_GAIN_SCALE * (1L << PID_INTEGRATOR_FRACTION_BITS));
 }
 //------------------------------------------------------------------------------
-void CPIDController::LatchValue(double* pValue, double minValue, double maxValue) {
+void CPIDController::LatchValue(long* pValue, long minValue, long maxValue) {
   if (*pValue < minValue)
     *pValue = minValue;
   else if (*pValue > maxValue)
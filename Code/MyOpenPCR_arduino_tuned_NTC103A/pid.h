@@ -16,32 +16,79 @@
  *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifndef _PID_H_
+#define _PID_H_
+
+//gains are fixed point, scaled by PID_GAIN_SCALE: kP in output per degree C, kI in
+//output per degree C second, kD in output seconds per degree C
+#define PID_GAIN_SCALE 100
+
+//the largest gains the fixed point arithmetic is written for, kI and kD for sample
+//periods of PID_MIN_SAMPLE_US to PID_MAX_SAMPLE_US; a schedule beyond them is clamped
+#define PID_MAX_KP (10000L * PID_GAIN_SCALE)
+#define PID_MAX_KI (1000L * PID_GAIN_SCALE)
+#define PID_MAX_KD (500L * PID_GAIN_SCALE)
+#define PID_MIN_SAMPLE_US 150000L
+#define PID_MAX_SAMPLE_US 200000L
+
+//the filtered measurement rate keeps PID_RATE_FRACTION_BITS below TEMP_SCALE units
+#define PID_RATE_FRACTION_BITS 5
+
+//a gain schedule point, gains between points are interpolated by target temperature
 struct SPIDTuning {
-  int maxValueInclusive;
-  double kP;
-  double kI;
-  double kD;
+  TTemp temp;
+  long kP;
+  long kI;
+  long kD;
 };
 
 ////////////////////////////////////////////////////////////////////
 // Class CPIDController
+//PID on a fixed sample period with gains interpolated from a schedule for each
+//direction. Gain changes are bumpless, the integrator is wound back by how far the
+//output saturated, and the derivative acts on how far the filtered rate of the
+//measurement falls behind the planned rate of the target.
 class CPIDController {
 public:
-  CPIDController(const SPIDTuning* pGainSchedule, int minOutput, int maxOutput);
+  CPIDController(const SPIDTuning* pHeatingSchedule, const SPIDTuning* pCoolingSchedule, uint8_t numPoints,
+                 int minOutput, int maxOutput, unsigned long sampleUs);
  
-  //accessors
-  double GetIntegrator() { return iIntegrator; }
+  //configuration
+  static boolean IsValidTuning(const SPIDTuning& tuning); //gains from 0 up to the limits above
+  void SetGainSchedule(const SPIDTuning* pHeatingSchedule, const SPIDTuning* pCoolingSchedule);
+  void SetCooling(boolean cooling); //selects the schedule
  
-  //computation
-  double Compute(double target, double currentValue);
+  //computation, once per sample period; a moving target passes its planned change per
+  //sample, PID_RATE_FRACTION_BITS below TEMP_SCALE, and the drive expected to follow it
+  int Compute(TTemp target, TTemp currentValue, long targetRate = 0, int feedforward = 0);
+  void Reset(TTemp currentValue, int output); //continues from output, e.g. after open loop drive
+  void ResetIntegrator() { iIntegrator = 0; }
 
 private:
-  const SPIDTuning* DetermineGainSchedule(double target);
-  void LatchValue(double* pValue, double minValue, double maxValue);
+  void UpdateGains(TTemp target, TTemp error, long rateError);
+  void AddToIntegrator(long outputChange);
+  void LatchValue(long* pValue, long minValue, long maxValue);
   
 private:
-  const SPIDTuning* ipGainSchedule;
+  const SPIDTuning* ipHeatingSchedule;
+  const SPIDTuning* ipCoolingSchedule;
+  uint8_t iNumPoints;
   int iMinOutput, iMaxOutput;
-  double iPreviousError;
-  double iIntegrator;
+  unsigned long iSampleUs;
+  
+  //gains for the current target, per sample
+  boolean iCooling;
+  boolean iGainsValid;
+  TTemp iGainTarget;
+  long iKp;
+  long iKiSample;
+  long iKdSample;
+  
+  //state
+  long iIntegrator;  //output scaled by TEMP_SCALE * PID_GAIN_SCALE, with fraction bits below that
+  TTemp iPreviousValue;
+  long iRate;        //filtered change of the measurement per sample
+  boolean iStarted;
 };
+
+#endif
@@ -20,9 +20,20 @@
 #include "program.h"
 
 #include <EEPROM.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
 
 #include "display.h"
 
+//a command streams in up to a packet, which holds more steps and loops than their
+//indexes reach, so the arena never needs more than the index limits can fill; below
+//that it is what the SRAM left gives
+#define PROGRAM_ARENA_MAX (PROGRAM_MAX_STEPS * sizeof(Step) + PROGRAM_MAX_LOOPS * sizeof(SProgramLoop))
+static_assert(PROGRAM_MAX_STEPS <= RUN_CHECKPOINT_IDLE, "a step index never reads as a run ended");
+//left free above the arena for the stack of the control tick, beyond the heap's own margin
+#define PROGRAM_STACK_RESERVE 256
+#define PROGRAM_ARENA_PROBE 16 //bytes between the arena sizes tried
+
 ////////////////////////////////////////////////////////////////////
 // Class Step
 void Step::SetName(const char* szName) {
@@ -31,97 +42,345 @@ void Step::SetName(const char* szName) {
 }
 
 void Step::Reset() {
-  iStepReturned = false;
   iStepDurationS = 0;
   iRampDurationS = 0;
   iTemp = 0;
   iName[0] = '\0'; 
 }
 
-void Step::BeginIteration() {
-  iStepReturned = false;
+////////////////////////////////////////////////////////////////////
+// Class Program
+Program::Program():
+  ipSteps(NULL),
+  ipLoopsEnd(NULL) {
+  Reset();
 }
 
-Step* Step::GetNextStep() {
-  if (iStepReturned) {
-    return NULL;
-  } else {
-    iStepReturned = true;
-    return this;
-  }
+void Program::AllocateArena() {
+  //the largest block the heap still gives with the reserve on top, in whole longs so
+  //the loop records at its end stay aligned
+  unsigned int size = PROGRAM_ARENA_MAX & ~(sizeof(long) - 1);
+  void* pArena;
+  while ((pArena = malloc(size + PROGRAM_STACK_RESERVE)) == NULL && size > PROGRAM_ARENA_PROBE)
+    size -= PROGRAM_ARENA_PROBE;
+  if (pArena == NULL)
+    return; //no arena, every program is too long
+  
+  pArena = realloc(pArena, size); //shrinks in place, freeing the reserve
+  ipSteps = (Step*)pArena;
+  ipLoopsEnd = (SProgramLoop*)((uint8_t*)pArena + size);
+  Reset();
 }
 
-////////////////////////////////////////////////////////////////////
-// Class Cycle
-ProgramComponent* Cycle::GetComponent(int index) {
-  return iComponents[index];
+int Program::GetNumCycles() {
+  return iDisplayLoop < 0 ? 1 : GetLoop(iDisplayLoop).numCycles;
 }
 
-PcrStatus Cycle::AddComponent(ProgramComponent* pComponent) {
-  if (iNumComponents >= MAX_CYCLE_ITEMS)
+int Program::GetCurrentCycle() {
+  if (iDisplayLoop < 0 || iCurrentLoop < iDisplayLoop)
+    return 1;
+  else if (iCurrentLoop > iDisplayLoop)
+    return GetNumCycles();
+  else
+    return iCurrentCycle + 1; //add 1 because cycles start at 0
+}
+
+void Program::Reset() {
+  iNumSteps = 0;
+  iNumLoops = 0;
+  iDisplayLoop = -1;
+  BeginIteration();
+}
+
+PcrStatus Program::BeginLoop(int numCycles) {
+  if (iNumLoops == PROGRAM_MAX_LOOPS || !HasRoom(sizeof(SProgramLoop)))
     return ETooManySteps;
   
-  iComponents[iNumComponents++] = pComponent;
+  SProgramLoop& loop = ipLoopsEnd[-1 - iNumLoops++];
+  loop.firstStep = iNumSteps;
+  loop.endStep = iNumSteps;
+  loop.numCycles = numCycles;
   return ESuccess;
 }
 
-void Cycle::Reset() {
-  iNumComponents = 0;
-  iNumCycles = 0;
-  iCurrentCycle = 0;
-  iCurrentComponent = 0;
+Step* Program::AddStep() {
+  if (iNumSteps == PROGRAM_MAX_STEPS || !HasRoom(sizeof(Step)))
+    return NULL;
+  
+  Step* pStep = &ipSteps[iNumSteps++];
+  pStep->Reset();
+  return pStep;
+}
+
+void Program::EndLoop() {
+  SProgramLoop& loop = ipLoopsEnd[-iNumLoops];
+  loop.endStep = iNumSteps;
+  if (loop.endStep == loop.firstStep) {
+    iNumLoops--; //nothing to repeat
+    return;
+  }
+  
+  //cycle numbers are shown for the loop repeated most, the first of equals
+  if (loop.numCycles > (iDisplayLoop < 0 ? 0 : GetLoop(iDisplayLoop).numCycles))
+    iDisplayLoop = iNumLoops - 1;
 }
 
 // iteration
-void Cycle::BeginIteration() {
+void Program::BeginIteration() {
+  iNextStep = 0;
+  iCurrentLoop = 0;
   iCurrentCycle = 0;
-  RestartCycle();
 }
 
-Step* Cycle::GetNextStep() {
-  //check for next step of existing component
-  Step* pNextStep = iComponents[iCurrentComponent]->GetNextStep();
-  
-  //advance to next component if current component done
-  if (pNextStep == NULL && ++iCurrentComponent < iNumComponents)
-    pNextStep = iComponents[iCurrentComponent]->GetNextStep(); //should never be NULL
-  
-  //advance to next cycle if current cycle done
-  if (pNextStep == NULL && ++iCurrentCycle < iNumCycles) {
-    RestartCycle();
-  
-    //return first component of that cycle
-    pNextStep = iComponents[iCurrentComponent]->GetNextStep(); //should never be NULL
+boolean Program::SeekStep(int stepIndex, int cycleIndex) {
+  //a loop of 0 cycles still runs once
+  for (uint8_t i = 0; i < iNumLoops; i++) {
+    const SProgramLoop& loop = GetLoop(i);
+    if (stepIndex >= loop.firstStep && stepIndex < loop.endStep) {
+      if (cycleIndex < 0 || (cycleIndex > 0 && cycleIndex >= loop.numCycles))
+        return false;
+      iNextStep = stepIndex;
+      iCurrentLoop = i;
+      iCurrentCycle = cycleIndex;
+      return true;
+    }
   }
-      
-  return pNextStep;
+  return false;
 }
 
-void Cycle::RestartCycle() {
-  iCurrentComponent = 0;
+Step* Program::GetNextStep() {
+  if (iCurrentLoop >= iNumLoops)
+    return NULL;
+  
+  //past the end of a loop, jump back for its next cycle or fall through to the next loop
+  const SProgramLoop& loop = GetLoop(iCurrentLoop);
+  if (iNextStep == loop.endStep) {
+    if (++iCurrentCycle < loop.numCycles) {
+      iNextStep = loop.firstStep;
+    } else {
+      iCurrentCycle = 0;
+      if (++iCurrentLoop == iNumLoops)
+        return NULL;
+    }
+  }
   
-  for (int i = 0; i < iNumComponents; i++)
-    iComponents[i]->BeginIteration();
+  return &ipSteps[iNextStep++];
+}
+
+boolean Program::HasRoom(unsigned int size) {
+  return (uint8_t*)(ipLoopsEnd - iNumLoops) - (uint8_t*)(ipSteps + iNumSteps) >= (long)size;
 }
 
 ////////////////////////////////////////////////////////////////////
 // Class CommandParser
-void CommandParser::ParseCommand(SCommand& command, char* pCommandBuf) {
-  char* pValue;
-  memset(&command, NULL, sizeof(command));
-  char buf[32];
+CommandParser::CommandParser():
+  ipCommand(NULL),
+  iState(EParamStart),
+  iProgramState(ELoopStart),
+  iKey(0),
+  iValueLength(0),
+  ipStep(NULL),
+  iStepField(0) {
+}
+
+void CommandParser::ParseCommand(SCommand& command, const char* szCommand) {
+  CommandParser parser;
+  parser.Begin(command);
+  while (*szCommand != '\0')
+    parser.Add(*szCommand++);
+  parser.Finish();
+}
+
+void CommandParser::Begin(SCommand& command) {
+  memset(&command, 0, sizeof(command));
+  gpThermocycler->Stop(); //need to stop here before the program is compiled over
+  
+  ipCommand = &command;
+  iState = EParamStart;
+}
+
+void CommandParser::Add(char ch) {
+  switch (iState) {
+  case EParamStart:
+    if (ch != '&') {
+      iKey = ch;
+      iState = EParamKey;
+    }
+    break;
+    
+  case EParamKey:
+    if (ch == '&') {
+      iState = EParamStart; //a parameter without a value is ignored
+    } else if (ch == '=' && iKey == 'p') {
+      ipCommand->pProgram = &gpThermocycler->GetProgram();
+      ipCommand->pProgram->Reset();
+      ipCommand->status = ESuccess;
+      iProgramState = ELoopStart;
+      iValueLength = 0;
+      iState = EProgram;
+    } else if (ch == '=') {
+      iValueLength = 0;
+      iState = EParamValue;
+    }
+    break;
+    
+  case EParamValue:
+    if (ch == '&') {
+      EndParam();
+      iState = EParamStart;
+    } else {
+      AddValueChar(ch);
+    }
+    break;
+    
+  case EProgram:
+    if (ch == '&') {
+      EndParam();
+      iState = EParamStart;
+    } else {
+      AddProgramChar(ch);
+    }
+    break;
+  }
+}
+
+void CommandParser::Finish() {
+  EndParam();
+  iState = EParamStart;
+}
+
+void CommandParser::EndParam() {
+  if (iState == EParamValue) {
+    iValue[iValueLength] = '\0';
+    AddComponent(ipCommand, iKey, iValue);
+  } else if (iState == EProgram) {
+    //every loop opened must have closed, unless the program already failed
+    if (iProgramState != ELoopStart && iProgramState != EProgramFailed)
+      Fail(EBadProgram);
+    if (iProgramState != EProgramFailed && ipCommand->pProgram->GetNumSteps() == 0)
+      Fail(EBadProgram); //nothing to run
+  }
+}
+
+//a program is loops such as (35[15|95|Den][20|55|Ann|10]), each a cycle count and
+//steps of hold, temperature, name and an optional ramp; whitespace may go between loops
+//and between steps, anything else out of place fails the program
+void CommandParser::AddProgramChar(char ch) {
+  boolean separator = ch == '(' || ch == ')';
+  switch (iProgramState) {
+  case ELoopStart:
+    if (ch == '(') {
+      iValueLength = 0;
+      iProgramState = ECycleCount;
+    } else if (!isspace(ch)) {
+      Fail(EBadProgram);
+    }
+    break;
+    
+  case ECycleCount:
+    //up to 4 digits, and at least one
+    if (ch == '[' ? iValueLength == 0 : !isdigit(ch) || iValueLength == 4) {
+      Fail(EBadProgram);
+    } else if (ch != '[') {
+      AddValueChar(ch);
+    } else {
+      iValue[iValueLength] = '\0';
+      PcrStatus status = ipCommand->pProgram->BeginLoop(atoi(iValue));
+      if (!SUCCEEDED(status)) {
+        Fail(status);
+        break;
+      }
+      AddStepChar(ch);
+    }
+    break;
+    
+  case EStep:
+    if (separator)
+      Fail(EBadProgram);
+    else
+      AddStepChar(ch);
+    break;
+    
+  case EAfterStep:
+    if (ch == '[')
+      AddStepChar(ch);
+    else if (ch == ')')
+      EndLoop();
+    else if (!isspace(ch))
+      Fail(EBadProgram);
+    break;
+    
+  case EProgramFailed:
+    break;
+  }
+}
 
-  gpThermocycler->Stop(); //need to stop here to reset program pools
+void CommandParser::AddStepChar(char ch) {
+  if (iProgramState != EStep) {
+    //'[' opens the step
+    ipStep = ipCommand->pProgram->AddStep();
+    if (ipStep == NULL) {
+      Fail(ETooManySteps);
+      return;
+    }
+    iStepField = 0;
+    iValueLength = 0;
+    iProgramState = EStep;
     
-  char* pParam = strtok(pCommandBuf, "&");
-  while (pParam) {  
-    pValue = strchr(pParam, '=');
-    *pValue++ = '\0';
-    AddComponent(&command, pParam[0], pValue);
-    pParam = strtok(NULL, "&");
+  } else if (ch == '|') {
+    EndStepField();
+    
+  } else if (ch == ']') {
+    //the name is the last field a step needs
+    if (iStepField < 2) {
+      Fail(EBadProgram);
+      return;
+    }
+    EndStepField();
+    iProgramState = EAfterStep;
+    
+  } else {
+    AddValueChar(ch);
   }
 }
 
+void CommandParser::AddValueChar(char ch) {
+  if (iValueLength < COMMAND_VALUE_LENGTH)
+    iValue[iValueLength++] = ch;
+}
+
+void CommandParser::EndStepField() {
+  iValue[iValueLength] = '\0';
+  switch (iStepField) {
+  case 0:
+    ipStep->SetStepDurationS(atol(iValue));
+    break;
+  case 1:
+    ipStep->SetTemp(ParseTemp(iValue));
+    break;
+  case 2:
+    ipStep->SetName(iValue);
+    break;
+  case 3:
+    ipStep->SetRampDurationS(atol(iValue));
+    break;
+  }
+  
+  if (iStepField < 4)
+    iStepField++;
+  iValueLength = 0;
+}
+
+void CommandParser::EndLoop() {
+  ipCommand->pProgram->EndLoop();
+  iProgramState = ELoopStart;
+}
+
+void CommandParser::Fail(PcrStatus status) {
+  ipCommand->status = status;
+  iProgramState = EProgramFailed;
+}
+
 void CommandParser::AddComponent(SCommand* pCommand, char key, char* szValue) {
   switch(key) {
   case 'n':
@@ -135,115 +394,526 @@ void CommandParser::AddComponent(SCommand* pCommand, char key, char* szValue) {
       pCommand->command = SCommand::EStop;
     else if (strcmp(szValue, "cfg") == 0)
       pCommand->command = SCommand::EConfig;
+    else if (strcmp(szValue, "autotune") == 0)
+      pCommand->command = SCommand::EAutotune;
+    else if (strcmp(szValue, "save") == 0)
+      pCommand->command = SCommand::ESave;
+    else if (strcmp(szValue, "run") == 0)
+      pCommand->command = SCommand::ERun;
     break;
   case 'l':
     pCommand->lidTemp = atoi(szValue);
     break;
+  case 'v':
+    pCommand->sampleVolume = atoi(szValue);
+    break;
+  case 'b':
+    pCommand->maxBlockOvershoot = ParseTemp(szValue);
+    break;
+  case 'h':
+    pCommand->preheatTemp = ParseTemp(szValue);
+    break;
+  case 's':
+    pCommand->slot = atoi(szValue);
+    break;
   case 'o':
     pCommand->contrast = atoi(szValue);
   case 'd':
     pCommand->commandId = atoi(szValue);
     break;
-  case 'p':
-    pCommand->pProgram = ParseProgram(szValue);
-    break;
   }
 }
 
-Cycle* CommandParser::ParseProgram(char* pBuffer) {
-  Cycle* pProgram = gpThermocycler->GetCyclePool().AllocateComponent();
-  pProgram->SetNumCycles(1);
-	
-  char* pCycBuf = strtok(pBuffer, "()");
-  while (pCycBuf != NULL) {
-    pProgram->AddComponent(ParseCycle(pCycBuf));
-    pCycBuf = strtok(NULL, "()");
+TTemp CommandParser::ParseTemp(const char* szValue) {
+  //decimal degrees to TEMP_SCALE units, rounding past the second decimal digit
+  boolean negative = *szValue == '-';
+  if (negative || *szValue == '+')
+    szValue++;
+  
+  long temp = 0;
+  while (*szValue >= '0' && *szValue <= '9')
+    temp = temp * 10 + *szValue++ - '0';
+  temp *= TEMP_SCALE;
+  
+  if (*szValue == '.') {
+    szValue++;
+    for (long place = TEMP_SCALE / 10; place > 0 && *szValue >= '0' && *szValue <= '9'; place /= 10)
+      temp += (*szValue++ - '0') * place;
+    if (*szValue >= '5' && *szValue <= '9')
+      temp++;
   }
   
-  return pProgram;
-}
-
-ProgramComponent* CommandParser::ParseCycle(char* pBuffer) {
-  char countBuf[5];
-	
-  //find first step
-  char* pStep = strchr(pBuffer, '[');
-	
-  //get cycle count
-  int countLen = pStep - pBuffer;
-  strncpy(countBuf, pBuffer, countLen);
-  countBuf[countLen] = '\0';
-  int cycCount = atoi(countBuf);
-  
-  Cycle* pCycle = gpThermocycler->GetCyclePool().AllocateComponent();
-  pCycle->SetNumCycles(cycCount);
-	
-  //add steps
-  while (pStep != NULL) {
-    *pStep++ = '\0';
-    char* pStepEnd = strchr(pStep, ']');
-    *pStepEnd++ = '\0';
-
-    Step* pNewStep = ParseStep(pStep);
-    pCycle->AddComponent(pNewStep);
-    pStep = strchr(pStepEnd, '[');
+  return negative ? -temp : temp;
+}
+
+
+//a binary command read in place, each read false once it would run past the end
+struct SBinaryReader {
+  const uint8_t* pData;
+  const uint8_t* pEnd;
+};
+
+static boolean ReadByte(SBinaryReader& reader, uint8_t& value) {
+  if (reader.pData >= reader.pEnd)
+    return false;
+  value = *reader.pData++;
+  return true;
+}
+
+static boolean ReadInt16(SBinaryReader& reader, int16_t& value) {
+  uint8_t low, high;
+  if (!ReadByte(reader, low) || !ReadByte(reader, high))
+    return false;
+  value = (int16_t)(low | (uint16_t)high << 8);
+  return true;
+}
+
+//7 bits a byte, the lowest first, the top bit set on all but the last
+static boolean ReadVarint(SBinaryReader& reader, unsigned long& value) {
+  value = 0;
+  for (uint8_t shift = 0; shift < 32; shift += 7) {
+    uint8_t data;
+    if (!ReadByte(reader, data))
+      return false;
+    value |= (unsigned long)(data & 0x7F) << shift;
+    if (!(data & 0x80))
+      return true;
   }
+  return false;
+}
+
+//a length and its characters, left where they are
+static boolean ReadString(SBinaryReader& reader, const uint8_t*& pChars, uint8_t& length) {
+  if (!ReadByte(reader, length) || reader.pEnd - reader.pData < length)
+    return false;
+  pChars = reader.pData;
+  reader.pData += length;
+  return true;
+}
+
+static void CopyString(char* pBuffer, int bufferSize, const uint8_t* pChars, uint8_t length) {
+  if (length >= bufferSize)
+    length = bufferSize - 1;
+  memcpy(pBuffer, pChars, length);
+  pBuffer[length] = '\0';
+}
 
-  return pCycle;
+//compiles the loops, each step named by its index into the names that start at names
+static PcrStatus ParseBinaryLoops(SBinaryReader& reader, uint8_t numLoops, const SBinaryReader& names, uint8_t numNames, Program* pProgram) {
+  pProgram->Reset();
+  for (int i = 0; i < numLoops; i++) {
+    unsigned long numCycles;
+    uint8_t numSteps;
+    if (!ReadVarint(reader, numCycles) || numCycles > 0x7FFF || !ReadByte(reader, numSteps))
+      return EBadProgram;
+    PcrStatus status = pProgram->BeginLoop(numCycles);
+    if (!SUCCEEDED(status))
+      return status;
+    
+    for (int j = 0; j < numSteps; j++) {
+      int16_t temp;
+      unsigned long stepDurationS, rampDurationS;
+      uint8_t nameIndex;
+      if (!ReadInt16(reader, temp) || !ReadVarint(reader, stepDurationS) || !ReadVarint(reader, rampDurationS) ||
+          !ReadByte(reader, nameIndex) || nameIndex >= numNames)
+        return EBadProgram;
+      
+      Step* pStep = pProgram->AddStep();
+      if (pStep == NULL)
+        return ETooManySteps;
+      pStep->SetTemp((long)temp * TEMP_SCALE / 100);
+      pStep->SetStepDurationS(stepDurationS);
+      pStep->SetRampDurationS(rampDurationS);
+      
+      SBinaryReader name = names;
+      const uint8_t* pChars = NULL;
+      uint8_t length = 0;
+      for (int k = 0; k <= nameIndex; k++)
+        ReadString(name, pChars, length);
+      char szName[STEP_NAME_LENGTH];
+      CopyString(szName, sizeof(szName), pChars, length);
+      pStep->SetName(szName);
+    }
+    pProgram->EndLoop();
+  }
+  
+  return reader.pData == reader.pEnd && pProgram->GetNumSteps() > 0 ? ESuccess : EBadProgram;
 }
 
-Step* CommandParser::ParseStep(char* pBuffer) {
-  //parse temp
-  char* pTemp = strchr(pBuffer, '|');
-  *pTemp++ = '\0';
+void CommandParser::ParseBinaryCommand(SCommand& command, const uint8_t* pData, int length) {
+  memset(&command, 0, sizeof(command));
+  gpThermocycler->Stop(); //need to stop here before the program is compiled over
   
-  //parse name
-  char* pName = strchr(pTemp, '|');
-  *pName++ = '\0';
+  //until it is read, a command is refused as a start so the status reports it
+  command.command = SCommand::EStart;
+  command.status = EBadProgram;
   
-  //parse ramp duration if exists
-  char* pEnd;
-  char* pRampDuration = strchr(pName, '|');
-  if (pRampDuration) {
-    *pRampDuration++ = '\0';
-    pEnd = strchr(pRampDuration, ']');
-  } else {
-    pEnd = strchr(pName, '|');
+  SBinaryReader reader = { pData, pData + length };
+  uint8_t version, type, nameLength, numNames;
+  unsigned long commandId, lidTemp, sampleVolume;
+  int16_t maxBlockOvershoot, preheatTemp;
+  const uint8_t* pName;
+  if (!ReadByte(reader, version) || version != BINARY_COMMAND_VERSION || !ReadByte(reader, type) ||
+      !ReadByte(reader, command.slot) || !ReadVarint(reader, commandId) || !ReadVarint(reader, lidTemp) ||
+      !ReadVarint(reader, sampleVolume) || !ReadInt16(reader, maxBlockOvershoot) || !ReadInt16(reader, preheatTemp) ||
+      !ReadString(reader, pName, nameLength) || !ReadByte(reader, numNames))
+    return;
+  if (type != SCommand::EStart && type != SCommand::EStop && type != SCommand::ESave && type != SCommand::ERun)
+    return;
+  
+  command.command = (SCommand::TCommandType)type;
+  command.commandId = commandId;
+  command.lidTemp = lidTemp;
+  command.sampleVolume = sampleVolume;
+  command.maxBlockOvershoot = (long)maxBlockOvershoot * TEMP_SCALE / 100;
+  command.preheatTemp = (long)preheatTemp * TEMP_SCALE / 100;
+  CopyString(command.name, sizeof(command.name), pName, nameLength);
+  
+  //the names are found by index, so only where they start is kept
+  SBinaryReader names = reader;
+  for (int i = 0; i < numNames; i++) {
+    if (!ReadString(reader, pName, nameLength))
+      return;
+  }
+  
+  //a command without loops has no program, like text without p=
+  uint8_t numLoops;
+  if (!ReadByte(reader, numLoops))
+    return;
+  if (numLoops > 0) {
+    command.pProgram = &gpThermocycler->GetProgram();
+    command.status = ParseBinaryLoops(reader, numLoops, names, numNames, command.pProgram);
+  } else if (reader.pData == reader.pEnd) {
+    command.status = ESuccess;
   }
-  *pEnd = '\0';
-	
-  unsigned long stepDuration = atol(pBuffer);
-  unsigned long rampDuration = pRampDuration == NULL ? 0 : atol(pRampDuration);
-  float temp = atof(pTemp);
-
-  Step* pStep = gpThermocycler->GetStepPool().AllocateComponent();
-  
-  pStep->SetName(pName);
-  pStep->SetStepDurationS(stepDuration);
-  pStep->SetRampDurationS(rampDuration);
-  pStep->SetTemp(temp);
-  return pStep;
 }
 
-
 ////////////////////////////////////////////////////////////////////
 // Class ProgramStore
 //
 // Note: Byte 0 of EEPROM is used for contrast
-//       Bytes 1 and onwards are used for stored program string
+//       Bytes 1 to MAX_COMMAND_SIZE are used for the stored program: a marker byte for
+//       a text or binary command, the length, the command and the CRC-16 of all before it
+//       Then a marker byte, the autotuned plate gain schedule and its checksum
+//       Then a marker byte, the learned ramp model and its checksum
+//       Then the program library: a directory of the length and CRC-16 of each slot,
+//       and the slots, each a compiled program and its settings
+//       The last bytes are the run journal, a ring of checkpoints each with a sequence
+//       number and a CRC-16
 //
+#define PLATE_GAINS_ADDRESS (MAX_COMMAND_SIZE + 1)
+#define PLATE_GAINS_MARKER 0xA6 //changes with the layout or units of SPlateGainSchedule
+#define RAMP_MODEL_ADDRESS (PLATE_GAINS_ADDRESS + sizeof(SPlateGainSchedule) + 2)
+#define RAMP_MODEL_MARKER 0xB1 //changes with the layout or units of SRampModel
+#define PROGRAM_ADDRESS 1
+#define PROGRAM_MARKER 0xC5
+#define PROGRAM_BINARY_MARKER 0xC6 //the record holds a binary command
+#define PROGRAM_HEADER_SIZE 2
+#define PROGRAM_MAX_LENGTH (MAX_COMMAND_SIZE - PROGRAM_HEADER_SIZE - 2)
+#define EEPROM_CRC_INIT 0xFFFF
+#define EEPROM_WRITE_COMPARES 16 //stored bytes checked per ready interrupt
+
+//each checkpoint goes to the entry after the last, so a run of 35 cycles writes each
+//entry about 7 times; a checkpoint torn by a reset fails its CRC and the one before stands
+#define JOURNAL_ENTRIES 16
+#define JOURNAL_ENTRY_SIZE (1 + sizeof(SRunCheckpoint) + 2)
+#define JOURNAL_ADDRESS (E2END + 1 - JOURNAL_ENTRIES * JOURNAL_ENTRY_SIZE)
+
+//the library shares out what is left between the ramp model and the journal; a slot
+//holds the standard 3 step, 35 cycle program with names in about 90 bytes
+#define LIBRARY_SLOTS 3
+#define LIBRARY_ADDRESS (RAMP_MODEL_ADDRESS + sizeof(SRampModel) + 2)
+#define LIBRARY_DIRECTORY_ENTRY_SIZE 3
+#define LIBRARY_SLOTS_ADDRESS (LIBRARY_ADDRESS + LIBRARY_SLOTS * LIBRARY_DIRECTORY_ENTRY_SIZE)
+#define LIBRARY_SLOT_SIZE ((JOURNAL_ADDRESS - LIBRARY_SLOTS_ADDRESS) / LIBRARY_SLOTS)
+#define LIBRARY_SIZE (LIBRARY_SLOTS_ADDRESS + LIBRARY_SLOTS * LIBRARY_SLOT_SIZE - LIBRARY_ADDRESS)
+#define MAX_SLOT_RAMP_S 0xFFFF
+static_assert(LIBRARY_SLOT_SIZE > 0 && LIBRARY_SLOT_SIZE <= 255, "a slot length is kept in one directory byte");
+static_assert(PROGRAM_HEADER_SIZE + 2 + LIBRARY_SLOT_SIZE <= MAX_COMMAND_SIZE,
+              "a slot is saved from the program record buffer, after the empty record");
+
+//a record the EEPROM ready interrupt writes one changed byte at a time while EERIE is
+//set, so storing it does not hold up the control loop
+struct SBackgroundWrite {
+  int address;
+  uint8_t* pData;
+  int size;
+  volatile int index;
+};
+
+//the record is a copy, as the serial buffer it comes from is reused before the write
+//ends; its 256 bytes come out of the program arena, about 11 steps on the target.
+//A slot being saved is encoded into the same buffer, after the empty record its save
+//command queued; its directory entry goes after it, so a save cut short fails its CRC
+static uint8_t sProgramRecord[MAX_COMMAND_SIZE];
+static uint8_t sCheckpointRecord[JOURNAL_ENTRY_SIZE];
+static uint8_t sDirectoryEntry[LIBRARY_DIRECTORY_ENTRY_SIZE];
+static uint8_t sRampModelRecord[1 + sizeof(SRampModel) + 1]; //stored as a run ends
+static SBackgroundWrite sBackgroundWrites[] = {
+  { PROGRAM_ADDRESS, sProgramRecord, 0, 0 },
+  { JOURNAL_ADDRESS, sCheckpointRecord, 0, 0 },
+  { LIBRARY_SLOTS_ADDRESS, sProgramRecord, 0, 0 },
+  { LIBRARY_ADDRESS, sDirectoryEntry, 0, 0 },
+  { RAMP_MODEL_ADDRESS, sRampModelRecord, 0, 0 }
+};
+#define BACKGROUND_WRITES (sizeof(sBackgroundWrites) / sizeof(sBackgroundWrites[0]))
+
+//the program record stored or retrieved last, checkpoints belong to it
+static uint16_t sProgramCrc = 0;
+static boolean sProgramStored = false;
+
+//where the next checkpoint goes
+static boolean sJournalScanned = false;
+static uint8_t sJournalEntry = 0;
+static uint8_t sJournalSequence = 0;
+static boolean sJournalIdle = true;
+
+//writes value unless the EEPROM already holds it, true if it started a write
+static boolean UpdateEeprom(int address, uint8_t value) {
+  if (EEPROM.read(address) == value)
+    return false;
+  EEPROM.write(address, value);
+  return true;
+}
+
+static uint16_t AddCrc16(uint16_t crc, const uint8_t* pData, int size) {
+  for (int i = 0; i < size; i++)
+    crc = _crc16_update(crc, pData[i]);
+  return crc;
+}
+
+static int GetSlotAddress(uint8_t slot) {
+  return LIBRARY_SLOTS_ADDRESS + (slot - 1) * LIBRARY_SLOT_SIZE;
+}
+
+static int GetDirectoryEntryAddress(uint8_t slot) {
+  return LIBRARY_ADDRESS + (slot - 1) * LIBRARY_DIRECTORY_ENTRY_SIZE;
+}
+
+//a slot being encoded into pBuffer, or decoded in place in EEPROM; encoding goes on
+//counting its length and CRC past maxLength
+struct SSlotStream {
+  int address;
+  int length;
+  int maxLength;
+  uint16_t crc;
+  uint8_t* pBuffer;
+};
+
+static void PutSlotBytes(SSlotStream& stream, const void* pData, int size) {
+  const uint8_t* pBytes = (const uint8_t*)pData;
+  for (int i = 0; i < size; i++, stream.length++) {
+    stream.crc = _crc16_update(stream.crc, pBytes[i]);
+    if (stream.length < stream.maxLength)
+      stream.pBuffer[stream.length] = pBytes[i];
+  }
+}
+
+static boolean GetSlotBytes(SSlotStream& stream, void* pData, int size) {
+  if (stream.length + size > stream.maxLength)
+    return false;
+  uint8_t* pBytes = (uint8_t*)pData;
+  for (int i = 0; i < size; i++)
+    pBytes[i] = EEPROM.read(stream.address + stream.length++);
+  return true;
+}
+
+static void PutSlotString(SSlotStream& stream, const char* szValue) {
+  uint8_t length = strlen(szValue);
+  PutSlotBytes(stream, &length, 1);
+  PutSlotBytes(stream, szValue, length);
+}
+
+static boolean GetSlotString(SSlotStream& stream, char* pBuffer, int bufferSize) {
+  uint8_t length;
+  if (!GetSlotBytes(stream, &length, 1) || length >= bufferSize || !GetSlotBytes(stream, pBuffer, length))
+    return false;
+  pBuffer[length] = '\0';
+  return true;
+}
+
+//the settings of the start command, then each loop with its steps in program order;
+//numbers are stored in the byte order of the target
+static void EncodeSlot(SSlotStream& stream, const SCommand& command) {
+  Program* pProgram = command.pProgram;
+  uint8_t lidTemp = command.lidTemp;
+  int16_t sampleVolume = command.sampleVolume;
+  uint8_t numLoops = pProgram->GetNumLoops();
+  PutSlotString(stream, command.name);
+  PutSlotBytes(stream, &lidTemp, sizeof(lidTemp));
+  PutSlotBytes(stream, &sampleVolume, sizeof(sampleVolume));
+  PutSlotBytes(stream, &command.maxBlockOvershoot, sizeof(command.maxBlockOvershoot));
+  PutSlotBytes(stream, &command.preheatTemp, sizeof(command.preheatTemp));
+  PutSlotBytes(stream, &numLoops, sizeof(numLoops));
+  
+  for (int i = 0; i < numLoops; i++) {
+    const SProgramLoop& loop = pProgram->GetLoop(i);
+    uint16_t numCycles = loop.numCycles;
+    uint8_t numSteps = loop.endStep - loop.firstStep;
+    PutSlotBytes(stream, &numCycles, sizeof(numCycles));
+    PutSlotBytes(stream, &numSteps, sizeof(numSteps));
+    
+    for (int j = loop.firstStep; j < loop.endStep; j++) {
+      Step* pStep = pProgram->GetStep(j);
+      TTemp temp = pStep->GetTemp();
+      uint16_t stepDurationS = pStep->GetStepDurationS();
+      uint16_t rampDurationS = pStep->GetRampDurationS() < MAX_SLOT_RAMP_S ? pStep->GetRampDurationS() : MAX_SLOT_RAMP_S;
+      PutSlotBytes(stream, &temp, sizeof(temp));
+      PutSlotBytes(stream, &stepDurationS, sizeof(stepDurationS));
+      PutSlotBytes(stream, &rampDurationS, sizeof(rampDurationS));
+      PutSlotString(stream, pStep->GetName());
+    }
+  }
+}
+
+//the slot compiled through the same calls as the parser, EBadProgram if it ends early
+static PcrStatus DecodeSlot(SSlotStream& stream, SCommand& command) {
+  Program* pProgram = command.pProgram;
+  uint8_t lidTemp, numLoops;
+  int16_t sampleVolume;
+  if (!GetSlotString(stream, command.name, sizeof(command.name)) ||
+      !GetSlotBytes(stream, &lidTemp, sizeof(lidTemp)) ||
+      !GetSlotBytes(stream, &sampleVolume, sizeof(sampleVolume)) ||
+      !GetSlotBytes(stream, &command.maxBlockOvershoot, sizeof(command.maxBlockOvershoot)) ||
+      !GetSlotBytes(stream, &command.preheatTemp, sizeof(command.preheatTemp)) ||
+      !GetSlotBytes(stream, &numLoops, sizeof(numLoops)))
+    return EBadProgram;
+  command.lidTemp = lidTemp;
+  command.sampleVolume = sampleVolume;
+  
+  pProgram->Reset();
+  for (int i = 0; i < numLoops; i++) {
+    uint16_t numCycles;
+    uint8_t numSteps;
+    if (!GetSlotBytes(stream, &numCycles, sizeof(numCycles)) || !GetSlotBytes(stream, &numSteps, sizeof(numSteps)))
+      return EBadProgram;
+    PcrStatus status = pProgram->BeginLoop(numCycles);
+    if (!SUCCEEDED(status))
+      return status;
+    
+    for (int j = 0; j < numSteps; j++) {
+      TTemp temp;
+      uint16_t stepDurationS, rampDurationS;
+      char szName[STEP_NAME_LENGTH];
+      if (!GetSlotBytes(stream, &temp, sizeof(temp)) ||
+          !GetSlotBytes(stream, &stepDurationS, sizeof(stepDurationS)) ||
+          !GetSlotBytes(stream, &rampDurationS, sizeof(rampDurationS)) ||
+          !GetSlotString(stream, szName, sizeof(szName)))
+        return EBadProgram;
+      
+      Step* pStep = pProgram->AddStep();
+      if (pStep == NULL)
+        return ETooManySteps;
+      pStep->SetTemp(temp);
+      pStep->SetStepDurationS(stepDurationS);
+      pStep->SetRampDurationS(rampDurationS);
+      pStep->SetName(szName);
+    }
+    pProgram->EndLoop();
+  }
+  
+  return ESuccess;
+}
+
+//queues a record filled in while EERIE was clear, a record already queued there is
+//abandoned where it got to
+static void BeginBackgroundWrite(SBackgroundWrite& write, int address, int size) {
+  write.address = address;
+  write.size = size;
+  write.index = 0;
+  EECR |= _BV(EERIE);
+}
+
+ISR(EE_READY_vect) {
+  //the EEPROM is ready, so a write only starts here and the next byte waits for the
+  //next interrupt; a batch of unchanged bytes also returns to keep the handler short
+  uint8_t compares = 0;
+  for (uint8_t i = 0; i < BACKGROUND_WRITES; i++) {
+    SBackgroundWrite& write = sBackgroundWrites[i];
+    while (write.index < write.size) {
+      if (compares++ == EEPROM_WRITE_COMPARES)
+        return;
+      int index = write.index++;
+      if (UpdateEeprom(write.address + index, write.pData[index]))
+        return;
+    }
+  }
+  EECR &= ~_BV(EERIE);
+}
+
+//writes out the background records that overlap the range and holds the others off,
+//so the range can be accessed directly with the control tick suspended; returns the
+//interrupt enable to restore once it is done
+static uint8_t PauseWrites(int address, int size) {
+  uint8_t writing = EECR & _BV(EERIE);
+  EECR &= ~_BV(EERIE);
+  for (uint8_t i = 0; i < BACKGROUND_WRITES; i++) {
+    SBackgroundWrite& write = sBackgroundWrites[i];
+    if (write.index < write.size && write.address < address + size && address < write.address + write.size) {
+      for (; write.index < write.size; write.index++)
+        UpdateEeprom(write.address + write.index, write.pData[write.index]);
+    }
+  }
+  return writing;
+}
+
 uint8_t ProgramStore::RetrieveContrast() {
+  FinishWrite();
   return EEPROM.read(0);
 }
 
-#define PROG_START_STR "&c=start"
+#define PROG_START_STR "c=start"
 const char PROG_START_STR_P[] PROGMEM = PROG_START_STR;
+#define PROG_RUN_STR "c=run"
+const char PROG_RUN_STR_P[] PROGMEM = PROG_RUN_STR;
+
+static boolean IsParam_P(const char* pParam, const char* szParam_P, int length) {
+  return strncmp_P(pParam, szParam_P, length) == 0 && (pParam[length] == '&' || pParam[length] == '\0');
+}
+
+//start commands and runs of a library slot are restarted, wherever c= is among the keys
+static boolean IsRestartCommand(const char* szCommand) {
+  for (const char* pParam = szCommand; pParam != NULL; pParam = strchr(pParam, '&')) {
+    if (*pParam == '&')
+      pParam++;
+    if (IsParam_P(pParam, PROG_START_STR_P, strlen(PROG_START_STR)) || IsParam_P(pParam, PROG_RUN_STR_P, strlen(PROG_RUN_STR)))
+      return true;
+  }
+  return false;
+}
+
 boolean ProgramStore::RetrieveProgram(SCommand& command, char* pBuffer) {
-  for (int i = 0; i < MAX_COMMAND_SIZE; i++)
-    pBuffer[i] = EEPROM.read(i + 1);
+  FinishWrite();
+  sProgramStored = false;
+  
+  //a record torn by a reset while it was written fails the CRC
+  uint8_t header[PROGRAM_HEADER_SIZE];
+  for (int i = 0; i < PROGRAM_HEADER_SIZE; i++)
+    header[i] = EEPROM.read(PROGRAM_ADDRESS + i);
+  int length = header[1];
+  if ((header[0] != PROGRAM_MARKER && header[0] != PROGRAM_BINARY_MARKER) || length > PROGRAM_MAX_LENGTH)
+    return false;
+  
+  for (int i = 0; i < length; i++)
+    pBuffer[i] = EEPROM.read(PROGRAM_ADDRESS + PROGRAM_HEADER_SIZE + i);
+  pBuffer[length] = '\0';
   
-  if (strncmp_P(pBuffer, PROG_START_STR_P, strlen(PROG_START_STR)) == 0) {
+  int crcAddress = PROGRAM_ADDRESS + PROGRAM_HEADER_SIZE + length;
+  uint16_t crc = AddCrc16(AddCrc16(EEPROM_CRC_INIT, header, PROGRAM_HEADER_SIZE), (uint8_t*)pBuffer, length);
+  if (EEPROM.read(crcAddress) != (crc & 0xFF) || EEPROM.read(crcAddress + 1) != (crc >> 8))
+    return false;
+  
+  if (header[0] == PROGRAM_BINARY_MARKER) {
+    //only restarted commands are stored binary
+    sProgramCrc = crc;
+    sProgramStored = true;
+    CommandParser::ParseBinaryCommand(command, (uint8_t*)pBuffer, length);
+    return true;
+    
+  } else if (IsRestartCommand(pBuffer)) {
     //previous program stored
+    sProgramCrc = crc;
+    sProgramStored = true;
     CommandParser::ParseCommand(command, pBuffer);   
     return true;
     
@@ -254,13 +924,236 @@ boolean ProgramStore::RetrieveProgram(SCommand& command, char* pBuffer) {
 
 
 
+boolean ProgramStore::RetrievePlateGains(SPlateGainSchedule& gains) {
+  return RetrieveBlock(PLATE_GAINS_ADDRESS, PLATE_GAINS_MARKER, &gains, sizeof(gains));
+}
+
+boolean ProgramStore::RetrieveRampModel(SRampModel& model) {
+  return RetrieveBlock(RAMP_MODEL_ADDRESS, RAMP_MODEL_MARKER, &model, sizeof(model));
+}
+
+boolean ProgramStore::RetrieveCheckpoint(SRunCheckpoint& checkpoint) {
+  return ScanJournal(checkpoint) && checkpoint.stepIndex != RUN_CHECKPOINT_IDLE &&
+         sProgramStored && checkpoint.programCrc == sProgramCrc;
+}
+
+PcrStatus ProgramStore::RetrieveSlot(SCommand& command) {
+  if (command.slot < 1 || command.slot > LIBRARY_SLOTS)
+    return EBadProgram;
+  
+  //only a save still being written is waited for, the program record and checkpoints
+  //go on once the slot is read
+  uint8_t writing = PauseWrites(LIBRARY_ADDRESS, LIBRARY_SIZE);
+  PcrStatus status = ReadSlot(command);
+  EECR |= writing;
+  return status;
+}
+
+PcrStatus ProgramStore::ReadSlot(SCommand& command) {
+  //an empty slot, or one torn by a reset while it was saved, fails its directory entry
+  int entryAddress = GetDirectoryEntryAddress(command.slot);
+  int length = EEPROM.read(entryAddress);
+  uint16_t crc = EEPROM.read(entryAddress + 1) | EEPROM.read(entryAddress + 2) << 8;
+  SSlotStream stream = { GetSlotAddress(command.slot), 0, length, EEPROM_CRC_INIT, NULL };
+  if (length == 0 || length > (int)LIBRARY_SLOT_SIZE)
+    return ENoProgram;
+  for (int i = 0; i < length; i++)
+    stream.crc = _crc16_update(stream.crc, EEPROM.read(stream.address + i));
+  if (stream.crc != crc)
+    return ENoProgram;
+  
+  return DecodeSlot(stream, command);
+}
+
 void ProgramStore::StoreContrast(uint8_t contrast) {
-  EEPROM.write(0, contrast);
+  //the byte is written with the control tick suspended, the records queued go on after it
+  uint8_t writing = PauseWrites(0, 1);
+  UpdateEeprom(0, contrast);
+  EECR |= writing;
 }
 
 void ProgramStore::StoreProgram(const char* szProgram) {
-  for (int i = 0; i < MAX_COMMAND_SIZE; i++)
-    EEPROM.write(i + 1, szProgram[i]);
+  //only a command that starts a program is restarted, any other leaves an empty record
+  int length = strlen(szProgram);
+  if (length > PROGRAM_MAX_LENGTH || !IsRestartCommand(szProgram))
+    length = 0;
+  StoreProgramRecord(PROGRAM_MARKER, (const uint8_t*)szProgram, length);
+}
+
+void ProgramStore::StoreBinaryProgram(const uint8_t* pCommand, int length) {
+  if (length > PROGRAM_MAX_LENGTH || length < 2 || (pCommand[1] != SCommand::EStart && pCommand[1] != SCommand::ERun))
+    StoreProgramRecord(PROGRAM_MARKER, pCommand, 0);
+  else
+    StoreProgramRecord(PROGRAM_BINARY_MARKER, pCommand, length);
+}
+
+void ProgramStore::StoreProgramRecord(uint8_t marker, const uint8_t* pCommand, int length) {
+  //a slot still being saved from the buffer is finished first
+  const SBackgroundWrite& slotWrite = sBackgroundWrites[2];
+  if (slotWrite.index < slotWrite.size)
+    FinishWrite();
+  
+  //a new record is written from its first byte, the bytes that differ in the same order
+  EECR &= ~_BV(EERIE);
+  sProgramRecord[0] = marker;
+  sProgramRecord[1] = length;
+  memcpy(sProgramRecord + PROGRAM_HEADER_SIZE, pCommand, length);
+  uint16_t crc = AddCrc16(EEPROM_CRC_INIT, sProgramRecord, PROGRAM_HEADER_SIZE + length);
+  sProgramRecord[PROGRAM_HEADER_SIZE + length] = crc & 0xFF;
+  sProgramRecord[PROGRAM_HEADER_SIZE + length + 1] = crc >> 8;
+  sProgramCrc = crc;
+  sProgramStored = length > 0;
+  BeginBackgroundWrite(sBackgroundWrites[0], PROGRAM_ADDRESS, PROGRAM_HEADER_SIZE + length + 2);
+}
+
+PcrStatus ProgramStore::StoreSlot(const SCommand& command) {
+  if (command.slot < 1 || command.slot > LIBRARY_SLOTS)
+    return EBadProgram;
+  if (command.pProgram == NULL)
+    return ENoProgram;
+  
+  //encoded into the record buffer after the record queued there, which for a save is the
+  //empty one, then queued with its directory entry; only an earlier save still being
+  //written waits, and a program that does not fit leaves the slot as it was
+  uint8_t writing = PauseWrites(LIBRARY_ADDRESS, LIBRARY_SIZE);
+  SBackgroundWrite& record = sBackgroundWrites[0];
+  int offset = record.index < record.size ? record.size : 0;
+  if (offset + (int)LIBRARY_SLOT_SIZE > MAX_COMMAND_SIZE) {
+    writing = PauseWrites(PROGRAM_ADDRESS, record.size) | writing;
+    offset = 0;
+  }
+  SSlotStream stream = { GetSlotAddress(command.slot), 0, LIBRARY_SLOT_SIZE, EEPROM_CRC_INIT, sProgramRecord + offset };
+  EncodeSlot(stream, command);
+  if (stream.length > (int)LIBRARY_SLOT_SIZE) {
+    EECR |= writing;
+    return ETooManySteps;
+  }
+  
+  sDirectoryEntry[0] = stream.length;
+  sDirectoryEntry[1] = stream.crc & 0xFF;
+  sDirectoryEntry[2] = stream.crc >> 8;
+  sBackgroundWrites[2].pData = stream.pBuffer;
+  BeginBackgroundWrite(sBackgroundWrites[2], stream.address, stream.length);
+  BeginBackgroundWrite(sBackgroundWrites[3], GetDirectoryEntryAddress(command.slot), LIBRARY_DIRECTORY_ENTRY_SIZE);
+  return ESuccess;
+}
+
+void ProgramStore::StorePlateGains(const SPlateGainSchedule& gains) {
+  StoreBlock(PLATE_GAINS_ADDRESS, PLATE_GAINS_MARKER, &gains, sizeof(gains));
+}
+
+void ProgramStore::StoreRampModel(const SRampModel& model) {
+  //in the background, as the block format of StoreBlock; one torn by a reset fails its
+  //checksum and the defaults stand
+  EECR &= ~_BV(EERIE);
+  uint8_t checksum = 0;
+  sRampModelRecord[0] = RAMP_MODEL_MARKER;
+  memcpy(sRampModelRecord + 1, &model, sizeof(model));
+  for (int i = 0; i < (int)sizeof(model); i++)
+    checksum += sRampModelRecord[1 + i];
+  sRampModelRecord[1 + sizeof(model)] = ~checksum;
+  BeginBackgroundWrite(sBackgroundWrites[4], RAMP_MODEL_ADDRESS, sizeof(sRampModelRecord));
+}
+
+void ProgramStore::StoreCheckpoint(SRunCheckpoint& checkpoint) {
+  SRunCheckpoint newest;
+  if (!sJournalScanned)
+    ScanJournal(newest);
+  
+  //a run of a program that is not stored cannot resume, and ending a run only needs
+  //to be journaled once
+  boolean idle = checkpoint.stepIndex == RUN_CHECKPOINT_IDLE;
+  if (idle ? sJournalIdle : !sProgramStored)
+    return;
+  checkpoint.programCrc = sProgramCrc;
+  
+  EECR &= ~_BV(EERIE);
+  sCheckpointRecord[0] = sJournalSequence++;
+  memcpy(sCheckpointRecord + 1, &checkpoint, sizeof(checkpoint));
+  uint16_t crc = AddCrc16(EEPROM_CRC_INIT, sCheckpointRecord, 1 + sizeof(checkpoint));
+  sCheckpointRecord[1 + sizeof(checkpoint)] = crc & 0xFF;
+  sCheckpointRecord[2 + sizeof(checkpoint)] = crc >> 8;
+  BeginBackgroundWrite(sBackgroundWrites[1], JOURNAL_ADDRESS + sJournalEntry * JOURNAL_ENTRY_SIZE, JOURNAL_ENTRY_SIZE);
+  
+  sJournalEntry = (sJournalEntry + 1) % JOURNAL_ENTRIES;
+  sJournalIdle = idle;
+}
+
+void ProgramStore::ClearCheckpoint() {
+  SRunCheckpoint checkpoint;
+  memset(&checkpoint, 0, sizeof(checkpoint));
+  checkpoint.stepIndex = RUN_CHECKPOINT_IDLE;
+  StoreCheckpoint(checkpoint);
+}
+
+boolean ProgramStore::RetrieveBlock(int address, uint8_t marker, void* pData, int size) {
+  FinishWrite();
+  if (EEPROM.read(address) != marker)
+    return false;
+  
+  uint8_t* pBytes = (uint8_t*)pData;
+  uint8_t checksum = 0;
+  for (int i = 0; i < size; i++)
+    checksum += pBytes[i] = EEPROM.read(address + 1 + i);
+  
+  return EEPROM.read(address + 1 + size) == (uint8_t)~checksum;
 }
 
+void ProgramStore::StoreBlock(int address, uint8_t marker, const void* pData, int size) {
+  const uint8_t* pBytes = (const uint8_t*)pData;
+  uint8_t checksum = 0;
+  FinishWrite();
+  UpdateEeprom(address, marker);
+  for (int i = 0; i < size; i++) {
+    UpdateEeprom(address + 1 + i, pBytes[i]);
+    checksum += pBytes[i];
+  }
+  UpdateEeprom(address + 1 + size, ~checksum);
+}
+
+void ProgramStore::FinishWrite() {
+  //direct access would race the interrupt for the address register, so the rest of the
+  //records is written here instead
+  if (!(EECR & _BV(EERIE)))
+    return;
+  
+  EECR &= ~_BV(EERIE);
+  for (uint8_t i = 0; i < BACKGROUND_WRITES; i++) {
+    SBackgroundWrite& write = sBackgroundWrites[i];
+    for (; write.index < write.size; write.index++)
+      UpdateEeprom(write.address + write.index, write.pData[write.index]);
+  }
+}
 
+boolean ProgramStore::ScanJournal(SRunCheckpoint& newest) {
+  //the background writes only pause, the journal is read while the interrupt is held off
+  uint8_t writing = EECR & _BV(EERIE);
+  EECR &= ~_BV(EERIE);
+  
+  //sequence numbers of whole entries are within JOURNAL_ENTRIES of each other, so the
+  //newest is ahead of every other one by a signed 8 bit difference
+  int newestEntry = -1;
+  uint8_t newestSequence = 0;
+  for (int i = 0; i < JOURNAL_ENTRIES; i++) {
+    uint8_t entry[JOURNAL_ENTRY_SIZE];
+    int address = JOURNAL_ADDRESS + i * JOURNAL_ENTRY_SIZE;
+    for (int j = 0; j < (int)JOURNAL_ENTRY_SIZE; j++)
+      entry[j] = EEPROM.read(address + j);
+    
+    uint16_t crc = AddCrc16(EEPROM_CRC_INIT, entry, JOURNAL_ENTRY_SIZE - 2);
+    if (entry[JOURNAL_ENTRY_SIZE - 2] != (crc & 0xFF) || entry[JOURNAL_ENTRY_SIZE - 1] != (crc >> 8))
+      continue;
+    if (newestEntry < 0 || (int8_t)(entry[0] - newestSequence) > 0) {
+      newestEntry = i;
+      newestSequence = entry[0];
+      memcpy(&newest, entry + 1, sizeof(newest));
+    }
+  }
+  EECR |= writing;
+  
+  sJournalScanned = true;
+  sJournalEntry = (newestEntry + 1) % JOURNAL_ENTRIES;
+  sJournalSequence = newestSequence + 1;
+  sJournalIdle = newestEntry < 0 || newest.stepIndex == RUN_CHECKPOINT_IDLE;
+  return newestEntry >= 0;
+}
@@ -19,110 +19,92 @@
 #ifndef _PROGRAM_H_
 #define _PROGRAM_H_
 
-class Step;
-
-////////////////////////////////////////////////////////////////////
-// Class ProgramComponent
-class ProgramComponent {
-public:
-  enum TType {
-    EStep = 0,
-    ECycle
-  };
-  
-  virtual void Reset() = 0;
-  virtual TType GetType() = 0;
-  
-  // iteration
-  virtual void BeginIteration() = 0;
-  virtual Step* GetNextStep() = 0;
-};
+struct SPlateGainSchedule;
+struct SRampModel;
 
 ////////////////////////////////////////////////////////////////////
 // Class Step
-class Step: public ProgramComponent {
+class Step {
 public:  
   // accessors
   char* GetName() { return iName; }
   unsigned int GetStepDurationS() { return iStepDurationS; }
   unsigned long GetRampDurationS() { return iRampDurationS; }
-  float GetTemp() { return iTemp; }
-  virtual TType GetType() { return EStep; }
+  TTemp GetTemp() { return iTemp; }
   boolean IsFinal() { return iStepDurationS == 0; }
 
   // mutators
   void SetStepDurationS(unsigned long stepDurationS) { iStepDurationS = stepDurationS; }
   void SetRampDurationS(unsigned long rampDurationS) { iRampDurationS = rampDurationS; }
-  void SetTemp(float temp) { iTemp = temp; }
+  void SetTemp(TTemp temp) { iTemp = temp; }
   void SetName(const char* szName);
   
-  virtual void Reset();
-  
-  // iteration
-  virtual void BeginIteration();
-  virtual Step* GetNextStep();
+  void Reset();
 
 private:
   unsigned int iStepDurationS; //in seconds
   unsigned long iRampDurationS; //in seconds, refers to ramp before the current step hold
-  float iTemp; // C
-  boolean iStepReturned;
+  TTemp iTemp; // in TEMP_SCALE units
   char iName[STEP_NAME_LENGTH];
 };
 
+//a cycle of the program, steps firstStep up to endStep run numCycles times before the
+//next loop; a loop that runs out of cycles jumps back to its first step
+struct SProgramLoop {
+  uint8_t firstStep;
+  uint8_t endStep;
+  int numCycles;
+};
+
+//step indexes are a byte short of RUN_CHECKPOINT_IDLE, and loop indexes fit iDisplayLoop
+#define PROGRAM_MAX_STEPS 255
+#define PROGRAM_MAX_LOOPS 128
+
 ////////////////////////////////////////////////////////////////////
-// Class Cycle
-class Cycle: public ProgramComponent {
+// Class Program
+//A program compiled flat: its steps in program order and a loop record for each
+//cycle over them. Iteration is a cursor of indexes into both. The records share one
+//arena, steps bumped up from its start and loops down from its end.
+class Program {
 public:
+  Program();
+  void AllocateArena(); //once at startup, takes the SRAM the heap has left
+  
   // accessors
-  virtual TType GetType() { return ECycle; }
-  int GetCurrentCycle() { return iCurrentCycle + 1; } //add 1 because cycles start at 0
-  int GetNumCycles() { return iNumCycles; }
-  int GetNumComponents() { return iNumComponents; }
-  ProgramComponent* GetComponent(int index);
+  int GetNumSteps() { return iNumSteps; }
+  Step* GetStep(int index) { return &ipSteps[index]; }
+  int GetNumLoops() { return iNumLoops; }
+  const SProgramLoop& GetLoop(int index) { return ipLoopsEnd[-1 - index]; }
+  int GetNumCycles(); //of the display loop, the one repeated most
+  int GetCurrentCycle();
+  int GetStepIndex() { return iNextStep - 1; } //of the step GetNextStep returned last
+  int GetCycleIndex() { return iCurrentCycle; } //of the loop that step is in, from 0
   
-  // mutators
-  void SetNumCycles(int numCycles) { iNumCycles = numCycles; }
-  PcrStatus AddComponent(ProgramComponent* pComponent); //takes ownership
-  virtual void Reset();
+  // compiling
+  void Reset();
+  PcrStatus BeginLoop(int numCycles);
+  Step* AddStep(); //to the loop begun, NULL when the arena is full
+  void EndLoop();
   
   // iteration
-  virtual void BeginIteration();
-  virtual Step* GetNextStep();
+  void BeginIteration();
+  boolean SeekStep(int stepIndex, int cycleIndex); //GetNextStep continues from there, false if out of range
+  Step* GetNextStep();
   
 private:
-  void RestartCycle();
-
+  boolean HasRoom(unsigned int size);
+  
 private:
-  ProgramComponent* iComponents[MAX_CYCLE_ITEMS];
-  int iNumComponents;
-  int iNumCycles;
+  Step* ipSteps;
+  SProgramLoop* ipLoopsEnd;
+  uint8_t iNumSteps;
+  uint8_t iNumLoops;
+  int8_t iDisplayLoop; //-1 for the program as a single cycle
   
+  // cursor
+  uint8_t iNextStep;
+  uint8_t iCurrentLoop;
   int iCurrentCycle;
-  int iCurrentComponent; // -1 means no component
-};
-
-////////////////////////////////////////////////////////////////////
-// Class ProgramComponentPool
-template <class T, int N>
-class ProgramComponentPool {
-public:
-  ProgramComponentPool() { iAllocatedComponents = 0; }
-
-  T* AllocateComponent() { 
-    if (iAllocatedComponents == N)
-      return NULL;
-      
-    T* pComponent = &iComponents[iAllocatedComponents++];
-    pComponent->Reset();
-    return pComponent;
-  }
-  
-  void ResetPool() { iAllocatedComponents = 0; }
-  
-private:
-  int iAllocatedComponents;
-  T iComponents[N];
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -134,24 +116,95 @@ struct SCommand {
     ENone = 0,
     EStart,
     EStop,
-    EConfig
+    EConfig,
+    EAutotune,
+    ESave,
+    ERun
   } command;
   int lidTemp;
+  int sampleVolume;        //uL, 0 to time step holds on the block
+  TTemp maxBlockOvershoot; //how far the block may pass the step to bring the sample in
+  TTemp preheatTemp;       //plate pre-hold while the lid heats, 0 to leave the plate off
   uint8_t contrast;
-  Cycle* pProgram;
+  uint8_t slot;            //of the program library, from 1
+  Program* pProgram;
+  PcrStatus status;        //ESuccess unless the program did not parse
 };
 
+//where a run is, journaled to EEPROM as it goes so it resumes there after a reset
+#define RUN_CHECKPOINT_IDLE 0xFF //step index once the run has ended, nothing to resume
+struct SRunCheckpoint {
+  uint32_t elapsedS;   //since the program began
+  uint16_t programCrc; //of the stored program record the run belongs to
+  uint16_t cycleIndex;
+  uint16_t holdS;      //of the step's hold already done
+  uint8_t stepIndex;
+};
+
+//binary commands, sent as SEND_BINARY_CMD packets with numbers little endian:
+//  version, command type, slot, varint command id, varint lid C, varint volume uL,
+//  int16 overshoot and preheat in 1/100 C, the name as a length and its characters
+//  the step names: a count, then each as a length and its characters
+//  the loops: a count, 0 for no program, then each as varint cycles and a step count,
+//  and its steps as int16 temperature in 1/100 C, varint hold s, varint ramp s and the
+//  index of a name
+#define BINARY_COMMAND_VERSION 1
+
+////////////////////////////////////////////////////////////////////
+//longest value kept, the name; the characters of longer values past it are dropped
+#define COMMAND_VALUE_LENGTH (sizeof(((SCommand*)0)->name) - 1)
+
 ////////////////////////////////////////////////////////////////////
 // Class CommandParser
+//Parses a text command a character at a time, as it arrives. The program is compiled
+//step by step as each one closes, so nothing waits for the end of the packet and a
+//program may be longer than the receive buffer.
 class CommandParser {
 public:
-  static void ParseCommand(SCommand& command, char* pCommandBuf);
+  CommandParser();
+  
+  //incremental parsing of one command
+  void Begin(SCommand& command); //stops the thermocycler, the program is compiled over
+  void Add(char ch);
+  void Finish();
+  
+  static void ParseCommand(SCommand& command, const char* szCommand); //all at once
+  static void ParseBinaryCommand(SCommand& command, const uint8_t* pData, int length);
 
 private:
+  void EndParam();
+  void AddProgramChar(char ch);
+  void AddStepChar(char ch);
+  void AddValueChar(char ch);
+  void EndStepField();
+  void EndLoop();
+  void Fail(PcrStatus status);
   static void AddComponent(SCommand* pCommand, char key, char* szValue);
-  static Cycle* ParseProgram(char* pBuffer);
-  static ProgramComponent* ParseCycle(char* pBuffer);
-  static Step* ParseStep(char* pBuffer);
+  static TTemp ParseTemp(const char* szValue);
+
+private:
+  enum TState {
+    EParamStart = 0,
+    EParamKey,   //waiting for the '='
+    EParamValue,
+    EProgram     //the value of p=
+  };
+  enum TProgramState {
+    ELoopStart = 0, //before the '(' of a loop
+    ECycleCount,
+    EStep,
+    EAfterStep,
+    EProgramFailed  //the rest of the program is skipped
+  };
+  
+  SCommand* ipCommand;
+  uint8_t iState;
+  uint8_t iProgramState;
+  char iKey;
+  char iValue[COMMAND_VALUE_LENGTH + 1]; //of the parameter or the step field being read
+  uint8_t iValueLength;
+  Step* ipStep;
+  uint8_t iStepField; //hold, temperature, name, ramp; any after those are ignored
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -161,10 +214,29 @@ public:
   //reading
   static uint8_t RetrieveContrast();
   static boolean RetrieveProgram(SCommand& command, char* pBuffer);
+  static boolean RetrievePlateGains(SPlateGainSchedule& gains);
+  static boolean RetrieveRampModel(SRampModel& model);
+  static boolean RetrieveCheckpoint(SRunCheckpoint& checkpoint); //of a run of the stored program left unfinished
+  static PcrStatus RetrieveSlot(SCommand& command); //compiles the slot into command.pProgram, with its settings
 
   //writing
   static void StoreContrast(uint8_t contrast);
-  static void StoreProgram(const char* szProgram);
+  static void StoreProgram(const char* szProgram); //in the background, a changed byte per EEPROM ready interrupt
+  static void StoreBinaryProgram(const uint8_t* pCommand, int length);
+  static PcrStatus StoreSlot(const SCommand& command); //the compiled program and its settings
+  static void StorePlateGains(const SPlateGainSchedule& gains);
+  static void StoreRampModel(const SRampModel& model); //in the background
+  static void StoreCheckpoint(SRunCheckpoint& checkpoint); //in the background, to the next journal entry
+  static void ClearCheckpoint(); //the run has ended
+
+private:
+  //a marker byte, the data and its checksum
+  static boolean RetrieveBlock(int address, uint8_t marker, void* pData, int size);
+  static void StoreBlock(int address, uint8_t marker, const void* pData, int size);
+  static void StoreProgramRecord(uint8_t marker, const uint8_t* pCommand, int length);
+  static PcrStatus ReadSlot(SCommand& command); //with the library writes paused
+  static void FinishWrite(); //of the background records, before any other EEPROM access
+  static boolean ScanJournal(SRunCheckpoint& newest); //and where the next checkpoint goes, false if none is whole
 };
   
 
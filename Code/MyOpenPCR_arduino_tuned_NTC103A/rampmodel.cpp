@@ -0,0 +1,190 @@
+/*
+ *  rampmodel.cpp - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pcr_includes.h"
+#include "rampmodel.h"
+
+//until the unit has learned its own, a second per degree either way
+#define RAMP_MODEL_DEFAULT_MS_PER_DEGREE 1000
+#define RAMP_MODEL_DEFAULT_SETTLE_MS 0
+
+//the first measurement replaces a default, each later one moves the model 1/2^n of the way;
+//a band crossed part way moves it by its share of the band, and not at all below a degree,
+//where the tick the block is read at is most of the time
+#define RAMP_MODEL_LEARN_BITS 3
+#define RAMP_MODEL_SETTLE_BIT RAMP_MODEL_BANDS
+#define RAMP_MODEL_MIN_LEARN_DEGREES TEMP_C(1)
+
+////////////////////////////////////////////////////////////////////
+// Class CRampModel
+CRampModel::CRampModel():
+  iActive(false),
+  iNumRamps(0),
+  iFromTemp(0),
+  iToTemp(0),
+  iStartMs(0),
+  iCrossing(false),
+  iBand(0),
+  iBandStartMs(0),
+  iBandStartTemp(0) {
+  Reset();
+}
+//------------------------------------------------------------------------------
+unsigned long CRampModel::PredictMs(TTemp fromTemp, TTemp toTemp) {
+  if (fromTemp == toTemp)
+    return 0;
+  
+  long ms = PredictCrossingMs(iModel, fromTemp, toTemp) + (toTemp > fromTemp ? iModel.heatingSettleMs : iModel.coolingSettleMs);
+  return ms > 0 ? ms : 0;
+}
+//------------------------------------------------------------------------------
+void CRampModel::Reset() {
+  for (uint8_t i = 0; i < RAMP_MODEL_BANDS; i++)
+    iModel.heatingMsPerDegree[i] = iModel.coolingMsPerDegree[i] = RAMP_MODEL_DEFAULT_MS_PER_DEGREE;
+  iModel.heatingSettleMs = iModel.coolingSettleMs = RAMP_MODEL_DEFAULT_SETTLE_MS;
+  iModel.heatingLearned = iModel.coolingLearned = 0;
+  iLearned = iModel;
+}
+//------------------------------------------------------------------------------
+void CRampModel::BeginRun() {
+  iLearned = iModel;
+  iActive = false;
+  iNumRamps = 0;
+}
+//------------------------------------------------------------------------------
+void CRampModel::BeginRamp(TTemp fromTemp, TTemp toTemp) {
+  iActive = fromTemp != toTemp;
+  iFromTemp = fromTemp;
+  iToTemp = toTemp;
+  iStartMs = millis();
+  iCrossing = iActive;
+  iBand = GetEdgeBand(fromTemp);
+  iBandStartMs = iStartMs;
+  iBandStartTemp = fromTemp;
+}
+//------------------------------------------------------------------------------
+void CRampModel::Update(TTemp plateTemp) {
+  if (!iActive || !iCrossing)
+    return;
+  
+  //the band the step is in is crossed up to the step, the rest of the ramp is settling
+  boolean heating = iToTemp > iFromTemp;
+  int8_t band = GetEdgeBand(plateTemp);
+  if (heating ? plateTemp >= iToTemp : plateTemp <= iToTemp) {
+    if (band == iBand)
+      LearnBand(iToTemp);
+    iCrossing = false;
+    return;
+  }
+  if (band == iBand)
+    return;
+  
+  //a band is left at its edge with the next
+  if (band == (heating ? iBand + 1 : iBand - 1)) {
+    TTemp edge = (heating ? band : iBand) * RAMP_MODEL_BAND_WIDTH;
+    LearnBand(edge);
+    iBandStartMs = millis();
+    iBandStartTemp = edge;
+  } else {
+    iBandStartMs = 0; //turned back or skipped a band
+  }
+  iBand = band;
+}
+//------------------------------------------------------------------------------
+void CRampModel::EndRamp() {
+  if (!iActive)
+    return;
+  
+  //a ramp may end within tolerance short of the step
+  if (iCrossing)
+    LearnBand(iToTemp);
+  long settleMs = (long)(millis() - iStartMs) - (long)PredictCrossingMs(iLearned, iFromTemp, iToTemp);
+  if (iToTemp > iFromTemp)
+    Learn(&iLearned.heatingSettleMs, &iLearned.heatingLearned, RAMP_MODEL_SETTLE_BIT, settleMs);
+  else
+    Learn(&iLearned.coolingSettleMs, &iLearned.coolingLearned, RAMP_MODEL_SETTLE_BIT, settleMs);
+  iActive = false;
+  if (iNumRamps < 255)
+    iNumRamps++;
+}
+//------------------------------------------------------------------------------
+void CRampModel::EndRun() {
+  iModel = iLearned;
+  iActive = false;
+}
+//------------------------------------------------------------------------------
+unsigned long CRampModel::PredictCrossingMs(const SRampModel& model, TTemp fromTemp, TTemp toTemp) {
+  const uint16_t* pRates = toTemp > fromTemp ? model.heatingMsPerDegree : model.coolingMsPerDegree;
+  TTemp low = toTemp > fromTemp ? fromTemp : toTemp;
+  TTemp high = toTemp > fromTemp ? toTemp : fromTemp;
+  
+  unsigned long ms = 0;
+  uint8_t lastBand = GetBand(high);
+  for (uint8_t band = GetBand(low); band <= lastBand; band++) {
+    TTemp bandLow = band == 0 ? low : band * RAMP_MODEL_BAND_WIDTH;
+    TTemp bandHigh = band == RAMP_MODEL_BANDS - 1 ? high : (band + 1) * RAMP_MODEL_BAND_WIDTH;
+    TTemp degrees = (high < bandHigh ? high : bandHigh) - (low > bandLow ? low : bandLow);
+    ms += (unsigned long)degrees * pRates[band] / TEMP_SCALE;
+  }
+  return ms;
+}
+//------------------------------------------------------------------------------
+uint8_t CRampModel::GetBand(TTemp temp) {
+  if (temp < 0)
+    return 0;
+  TTemp band = temp / RAMP_MODEL_BAND_WIDTH;
+  return band < RAMP_MODEL_BANDS ? band : RAMP_MODEL_BANDS - 1;
+}
+//------------------------------------------------------------------------------
+int8_t CRampModel::GetEdgeBand(TTemp temp) {
+  if (temp < 0)
+    return -1;
+  TTemp band = temp / RAMP_MODEL_BAND_WIDTH;
+  return band < RAMP_MODEL_BANDS ? band : RAMP_MODEL_BANDS;
+}
+//------------------------------------------------------------------------------
+void CRampModel::LearnBand(TTemp temp) {
+  TTemp degrees = abs(temp - iBandStartTemp);
+  if (iBandStartMs == 0 || iBand < 0 || iBand >= RAMP_MODEL_BANDS || degrees < RAMP_MODEL_MIN_LEARN_DEGREES)
+    return;
+  
+  boolean heating = iToTemp > iFromTemp;
+  uint16_t* pRates = heating ? iLearned.heatingMsPerDegree : iLearned.coolingMsPerDegree;
+  uint16_t* pLearned = heating ? &iLearned.heatingLearned : &iLearned.coolingLearned;
+  Learn(&pRates[iBand], pLearned, iBand, (long)(millis() - iBandStartMs) * TEMP_SCALE / degrees, degrees);
+}
+//------------------------------------------------------------------------------
+void CRampModel::Learn(uint16_t* pValue, uint16_t* pLearned, uint8_t bit, long sample, TTemp degrees) {
+  //a default is replaced by the first whole band, and until then moved by each share
+  sample = constrain(sample, 0, 0xFFFFL);
+  long step = (sample - (long)*pValue) * degrees / RAMP_MODEL_BAND_WIDTH;
+  if (*pLearned & (1 << bit))
+    *pValue = (long)*pValue + (step >> RAMP_MODEL_LEARN_BITS);
+  else
+    *pValue = (long)*pValue + step;
+  if (degrees >= RAMP_MODEL_BAND_WIDTH)
+    *pLearned |= 1 << bit;
+}
+//------------------------------------------------------------------------------
+void CRampModel::Learn(int16_t* pValue, uint16_t* pLearned, uint8_t bit, long sample) {
+  sample = constrain(sample, -0x8000L, 0x7FFFL);
+  if (*pLearned & (1 << bit))
+    *pValue = (long)*pValue + ((sample - (long)*pValue) >> RAMP_MODEL_LEARN_BITS);
+  else
+    *pValue = sample;
+  *pLearned |= 1 << bit;
+}
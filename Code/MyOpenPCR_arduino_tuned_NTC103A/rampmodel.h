@@ -0,0 +1,85 @@
+/*
+ *  rampmodel.h - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RAMPMODEL_H_
+#define _RAMPMODEL_H_
+
+//temperature bands from 0 to 100 C; a block outside them is predicted at the rate of
+//the band next to it
+#define RAMP_MODEL_BANDS 10
+#define RAMP_MODEL_BAND_WIDTH TEMP_C(10)
+
+//what a fast ramp takes on this unit, per direction: the time to cross a degree in each
+//band, and the time beyond reaching the step to settle onto it
+struct SRampModel {
+  uint16_t heatingMsPerDegree[RAMP_MODEL_BANDS];
+  uint16_t coolingMsPerDegree[RAMP_MODEL_BANDS];
+  int16_t heatingSettleMs;
+  int16_t coolingSettleMs;
+  uint16_t heatingLearned; //a bit per band, then one for the settling time, once measured
+  uint16_t coolingLearned;
+};
+
+////////////////////////////////////////////////////////////////////
+// Class CRampModel
+//Fast ramp durations of the unit, for the time remaining. Each ramp of a run refines
+//a copy of the model: the time through each band it crosses gives the rate there, a
+//band crossed part way in proportion to the distance, and whatever the ramp took
+//beyond the rates of the bands it crossed, the settling time. Predictions
+//keep to the model the run started with, so estimates within a run stay comparable.
+class CRampModel {
+public:
+  CRampModel();
+  
+  //accessors
+  SRampModel& GetModel() { return iModel; }
+  unsigned long PredictMs(TTemp fromTemp, TTemp toTemp);
+  uint8_t GetNumRamps() { return iNumRamps; } //learned from in this run
+  
+  //configuration
+  void Reset(); //the defaults, until the unit has learned its own
+  
+  //learning, from Loop() while a fast ramp runs
+  void BeginRun();
+  void BeginRamp(TTemp fromTemp, TTemp toTemp);
+  void Update(TTemp plateTemp);
+  void EndRamp();
+  void EndRun(); //predictions from now on use what the run learned
+  
+private:
+  unsigned long PredictCrossingMs(const SRampModel& model, TTemp fromTemp, TTemp toTemp);
+  uint8_t GetBand(TTemp temp);
+  int8_t GetEdgeBand(TTemp temp); //-1 below the bands, RAMP_MODEL_BANDS above
+  void LearnBand(TTemp temp); //the rate from where the block started in iBand to temp
+  void Learn(uint16_t* pValue, uint16_t* pLearned, uint8_t bit, long sample, TTemp degrees);
+  void Learn(int16_t* pValue, uint16_t* pLearned, uint8_t bit, long sample);
+  
+private:
+  SRampModel iModel;
+  SRampModel iLearned;
+  boolean iActive;
+  uint8_t iNumRamps;
+  TTemp iFromTemp;
+  TTemp iToTemp;
+  unsigned long iStartMs;
+  boolean iCrossing; //until the block reaches the step
+  int8_t iBand;
+  unsigned long iBandStartMs; //0 once the block turned back or skipped a band
+  TTemp iBandStartTemp;
+};
+
+#endif
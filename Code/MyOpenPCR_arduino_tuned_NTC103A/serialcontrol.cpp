@@ -27,14 +27,16 @@
 #define BAUD_RATE 4800
 
 SerialControl::SerialControl(Display* pDisplay)
-: ipDisplay(pDisplay)
-, packetState(STATE_START)
+: packetState(STATE_START)
+, lastPacketSeq(0xff)
 , packetLen(0)
 , packetRealLen(0)
-, lastPacketSeq(0xff)
-, bEscapeCodeFound(false)
 , iCommandId(0)
+, bEscapeCodeFound(false)
+, bStreamingCommand(false)
+, iCommandLength(0)
 , iReceivedStatusRequest(false)
+, ipDisplay(pDisplay)
 {  
   Serial.begin(BAUD_RATE);
 }
@@ -64,14 +66,13 @@ boolean SerialControl::ReadPacket()
       } 
       else if (packetState == STATE_PACKETLEN_LOW) {
         packetLen |= incomingByte << 8;
-        if (packetLen > MAX_COMMAND_SIZE)
-          packetLen = MAX_COMMAND_SIZE;
-        if (packetLen >= sizeof(struct PCPPacket) && packetLen <= MAX_COMMAND_SIZE) {
+        if (packetLen >= sizeof(struct PCPPacket) && packetLen <= MAX_PACKET_LENGTH) {
           packetState = STATE_PACKETHEADER_DONE;
           buf[0] = START_CODE;
           buf[1] = packetLen & 0xff;
           buf[2] = (packetLen & 0xff00)>>8;
           bEscapeCodeFound = false;
+          bStreamingCommand = false;
           packetRealLen = 3;
           packetLen -= 3;
         }
@@ -94,16 +95,38 @@ boolean SerialControl::ReadPacket()
       byte incomingByte = Serial.read();
       availableBytes--;
       packetLen--;
+      if (bStreamingCommand) {
+        //an escape char is held until the next shows whether it is one
+        if (bEscapeCodeFound && incomingByte != START_CODE)
+          AddCommandChar(ESCAPE_CODE);
+        bEscapeCodeFound = incomingByte == ESCAPE_CODE;
+        if (!bEscapeCodeFound)
+          AddCommandChar(incomingByte);
+        continue;
+      }
+      
       if (incomingByte == ESCAPE_CODE)
         bEscapeCodeFound = true;
       else if (bEscapeCodeFound && incomingByte == START_CODE)
         packetRealLen--; //erase the escape char
       else
         bEscapeCodeFound = false;
-      buf[packetRealLen++] = incomingByte; 
+      if (packetRealLen < MAX_COMMAND_SIZE)
+        buf[packetRealLen++] = incomingByte;
+      
+      //text commands are parsed as they arrive, rather than from the buffer once complete
+      if (packetRealLen == sizeof(PCPPacket) && (incomingByte & 0xf0) == SEND_CMD) {
+        bStreamingCommand = true;
+        iCommandLength = 0;
+        GetThermocycler().SuspendControl();
+        iCommandParser.Begin(iCommand);
+        GetThermocycler().ResumeControl();
+      }
     }
     
     if (packetLen == 0) {
+      if (bStreamingCommand && bEscapeCodeFound)
+        AddCommandChar(ESCAPE_CODE);
       ProcessPacket(buf, packetRealLen);
   
       //reset, to find START_CODE again
@@ -117,25 +140,45 @@ boolean SerialControl::ReadPacket()
     return false;
 }
 
+void SerialControl::AddCommandChar(byte ch) {
+  iCommandParser.Add(ch);
+  if (packetRealLen < MAX_COMMAND_SIZE)
+    buf[packetRealLen++] = ch;
+  iCommandLength++;
+}
+
 void SerialControl::ProcessPacket(byte* data, int datasize)
 {
   PCPPacket* packet = (PCPPacket*)data;
   uint8_t packetType = packet->eType & 0xf0;
   uint8_t packetSeq = packet->eType & 0x0f;
-  uint8_t result = false;
   char* pCommandBuf;
+  byte* pData;
+  SCommand command;
   
   switch(packetType){
   case SEND_CMD:
     data[datasize] = '\0';
-    SCommand command;
     pCommandBuf = (char*)(data + sizeof(PCPPacket));
     
-    //store start commands for restart
-    ProgramStore::StoreProgram(pCommandBuf);
+    //store start commands for restart, unless too long for the buffer and the record
+    ProgramStore::StoreProgram(datasize - sizeof(PCPPacket) == iCommandLength ? pCommandBuf : "");
+    
+    GetThermocycler().SuspendControl();
+    iCommandParser.Finish();
+    GetThermocycler().ProcessCommand(iCommand);
+    GetThermocycler().ResumeControl();
+    iCommandId = iCommand.commandId;
+    break;
+    
+  case SEND_BINARY_CMD:
+    pData = data + sizeof(PCPPacket);
+    ProgramStore::StoreBinaryProgram(pData, datasize - sizeof(PCPPacket));
     
-    CommandParser::ParseCommand(command, pCommandBuf);
+    GetThermocycler().SuspendControl();
+    CommandParser::ParseBinaryCommand(command, pData, datasize - sizeof(PCPPacket));
     GetThermocycler().ProcessCommand(command);
+    GetThermocycler().ResumeControl();
     iCommandId = command.commandId;
     break;
     
@@ -163,8 +206,8 @@ void SerialControl::SendStatus() {
     
   statusPtr = AddParam(statusPtr, 'd', (unsigned long)iCommandId, true);
   statusPtr = AddParam_P(statusPtr, 's', szStatus);
-  statusPtr = AddParam(statusPtr, 'l', (int)tc.GetLidTemp());
-  statusPtr = AddParam(statusPtr, 'b', tc.GetPlateTemp(), 1, false);
+  statusPtr = AddParam(statusPtr, 'l', tc.GetLidTemp() / TEMP_SCALE);
+  statusPtr = AddTempParam(statusPtr, 'b', tc.GetPlateTemp(), false);
   statusPtr = AddParam_P(statusPtr, 't', szThermState);
   statusPtr = AddParam(statusPtr, 'o', GetThermocycler().GetDisplay()->GetContrast());
 
@@ -177,7 +220,13 @@ void SerialControl::SendStatus() {
     if (tc.GetCurrentStep() != NULL)
       statusPtr = AddParam(statusPtr, 'p', tc.GetCurrentStep()->GetName());
       
-  } else if (state == Thermocycler::EIdle) {
+  } else if (state == Thermocycler::EError) {
+    statusPtr = AddParam(statusPtr, 'x', tc.GetErrorStatus());
+    
+  } else if (state == Thermocycler::EStopped) {
+    statusPtr = AddParam(statusPtr, 'f', BINARY_COMMAND_VERSION); //binary commands understood
+    
+  } else if (state == Thermocycler::EStartup) {
     statusPtr = AddParam(statusPtr, 'v', OPENPCR_FIRMWARE_VERSION_STRING);
   }
   statusPtr++; //to include null terminator
@@ -216,12 +265,12 @@ char* SerialControl::AddParam(char* pBuffer, char key, unsigned long val, boolea
   return pBuffer;
 }
 
-char* SerialControl::AddParam(char* pBuffer, char key, float val, int decimalDigits, boolean pad, boolean init) {
+char* SerialControl::AddTempParam(char* pBuffer, char key, TTemp val, boolean pad, boolean init) {
   if (!init)
     *pBuffer++ = '&';
   *pBuffer++ = key;
   *pBuffer++ = '=';
-  sprintFloat(pBuffer, val, decimalDigits, pad);
+  sprintTemp(pBuffer, val, pad);
   while (*pBuffer != '\0')
     pBuffer++;
     
@@ -258,6 +307,7 @@ const char RUNNING_STR[] PROGMEM = "running";
 const char COMPLETE_STR[] PROGMEM = "complete";
 const char STARTUP_STR[] PROGMEM = "startup";
 const char ERROR_STR[] PROGMEM = "error";
+const char AUTOTUNE_STR[] PROGMEM = "autotune";
 const char* SerialControl::GetProgramStateString_P(Thermocycler::ProgramState state) {
   switch (state) {
   case Thermocycler::EStopped:
@@ -270,6 +320,8 @@ const char* SerialControl::GetProgramStateString_P(Thermocycler::ProgramState st
     return COMPLETE_STR;
   case Thermocycler::EStartup:
     return STARTUP_STR;
+  case Thermocycler::EAutotune:
+    return AUTOTUNE_STR;
   case Thermocycler::EError:
   default:
     return ERROR_STR;
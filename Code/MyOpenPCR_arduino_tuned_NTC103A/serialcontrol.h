@@ -23,21 +23,23 @@
 
 #define START_CODE    0xFF
 #define ESCAPE_CODE   0xFE
+//text commands are parsed as they arrive, so only a garbled header claims more
+#define MAX_PACKET_LENGTH 4096
 
 class Display;
-class ProgramComponent;
-class Cycle;
+class Program;
 class Step;
 struct SCommand;
 
 typedef enum {
     SEND_CMD       = 0x10,
+    SEND_BINARY_CMD = 0x20, //START_CODE in the payload is sent after ESCAPE_CODE
     STATUS_REQ     = 0x40,
     STATUS_RESP    = 0x80
 } PACKET_TYPE;
 
-//packet header
-struct PCPPacket {
+//packet header, packed so the layout matches the wire on any target
+struct __attribute__((packed)) PCPPacket {
   PCPPacket(PACKET_TYPE type)
   : startCode(START_CODE)
   , length(0)
@@ -60,12 +62,13 @@ public:
   
 private:
   boolean ReadPacket(); //returns true if bytes were read
+  void AddCommandChar(byte ch);
   void ProcessPacket(byte* data, int datasize);
   void SendStatus();
 
   char* AddParam(char* pBuffer, char key, int val, boolean init = false);  
   char* AddParam(char* pBuffer, char key, unsigned long val, boolean init = false);
-  char* AddParam(char* pBuffer, char key, float val, int decimalDigits, boolean pad, boolean init = false);
+  char* AddTempParam(char* pBuffer, char key, TTemp val, boolean pad, boolean init = false);
   char* AddParam(char* pBuffer, char key, const char* szVal, boolean init = false);
   char* AddParam_P(char* pBuffer, char key, const char* szVal, boolean init = false);
   
@@ -86,6 +89,10 @@ private:
   uint8_t lastPacketSeq;
   uint16_t packetLen, packetRealLen, iCommandId;
   boolean bEscapeCodeFound;
+  boolean bStreamingCommand;
+  uint16_t iCommandLength; //of the text command streamed to the parser, kept in buf while it fits
+  CommandParser iCommandParser;
+  SCommand iCommand;
   boolean iReceivedStatusRequest;
   
   Display* ipDisplay;
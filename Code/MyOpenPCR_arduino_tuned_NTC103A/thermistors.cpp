@@ -18,48 +18,43 @@
 
 #include "pcr_includes.h"
 #include "thermistors.h"
+#include "thermistor_table.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#ifdef PLATE_ADC_MCP342X
+#include "../Wire/Wire.h"
+#endif
 
-// lid resistance table, in Ohms
-PROGMEM const unsigned int LID_RESISTANCE_TABLE[] = {  
-33890,32138,30487,28933,27468,26088,24785,23557,22397,21302,
-20268,19291,18367,17493,16667,15885,15145,14444,13780,13151
-12554,11988,11452,10942,10459,10000,9564,9150,8756,8382
-8026,7687,7365,7058,6765,6487,6222,5969,5728,5499
-5279,5070,4871,4680,4498,4324,4158,4000,3848,3703
-3564,3431,3304,3183,3066,2955,2848,2746,2648,2554
-2463,2377,2294,2215,2138,2065,1995,1927,1862,1800
-1740,1682,1627,1574,1522,1473,1426,1380,1336,1294
-1253,1214,1176,1140,1105,1071,1038,1007,977,947
-919,892,866,840,816,792,769,747,726,705
-685,666,648,630,612,595,579,563,548,533
-519,505,492,479,466,454,442,431,420,409
-399,389,379,369,360,351
-
-
-
-
-
+// thermistor: 10k NTC103A, Beta 3977, below a 2.2k pull-up to the ADC reference
+struct SNtc103aThermistor {
+  static constexpr double A = BetaA(10000, 3977);
+  static constexpr double B = BetaB(3977);
+  static constexpr double C = 0;
+  static constexpr double PULL_UP_OHMS = 2200;
 };
 
-// plate resistance table, in 0.1 Ohms
-PROGMEM const unsigned long PLATE_RESISTANCE_TABLE[] = {
-411749,382827,356157,331548,308825,287832,268423,250469,233850,218457
-204192,190964,178691,167297,156712,146875,137727,129215,121291,113910
-107031,100617,94633,89048,83831,78958,74402,70141,66154,62421
-58925,55649,52578,49698,46995,44458,42075,39836,37731,35752
-33890,32138,30487,28933,27468,26088,24785,23557,22397,21302
-20268,19291,18367,17493,16667,15885,15145,14444,13780,13151
-12554,11988,11452,10942,10459,10000,9564,9150,8756,8382
-8026,7687,7365,7058,6765,6487,6222,5969,5728,5499
-5279,5070,4871,4680,4498,4324,4158,4000,3848,3703
-3564,3431,3304,3183,3066,2955,2848,2746,2648,2554
-2463,2377,2294,2215,2138,2065,1995,1927,1862,1800
-1740,1682,1627,1574,1522,1473,1426,1380,1336,1294
-1253,1214,1176,1140,1105,1071,1038,1007,977,947
-919,892,866,840,816,792,769,747,726,705
-685,666,648,630,612,595
+// lid: 10 bit ATmega ADC, oversampled to 13 bits
+struct SLidSensor: SNtc103aThermistor {
+  static constexpr unsigned long ADC_FULL_SCALE = 8192;
+  static const uint8_t CODE_BITS = 13;
+  static const uint8_t TABLE_BITS = 7;
+};
 
+#ifdef PLATE_ADC_MCP342X
+// plate: MCP342x codes scaled to 18 bit, divider excited from the 2.048 V full scale
+struct SPlateSensor: SNtc103aThermistor {
+  static constexpr unsigned long ADC_FULL_SCALE = 0x20000;
+  static const uint8_t CODE_BITS = 17;
+  static const uint8_t TABLE_BITS = 8;
 };
+#else
+// plate: 21 bit LTC2400 class ADC
+struct SPlateSensor: SNtc103aThermistor {
+  static constexpr unsigned long ADC_FULL_SCALE = 0x1FFFFF;
+  static const uint8_t CODE_BITS = 21;
+  static const uint8_t TABLE_BITS = 8;
+};
+#endif
   
 //spi
 #define DATAOUT 11//MOSI
@@ -67,58 +62,173 @@ PROGMEM const unsigned long PLATE_RESISTANCE_TABLE[] = {
 #define SPICLOCK  13//sck
 #define SLAVESELECT 10//ss
 
-//------------------------------------------------------------------------------
-float TableLookup(const unsigned long lookupTable[], unsigned int tableSize, int startValue, unsigned long searchValue) {
-  //simple linear search for now
-  int i;
-  for (i = 0; i < tableSize; i++) {
-    if (searchValue >= pgm_read_dword_near(lookupTable + i))
-      break;
-  }
-  
-  if (i > 0) {
-    unsigned long high_val = pgm_read_dword_near(lookupTable + i - 1);
-    unsigned long low_val = pgm_read_dword_near(lookupTable + i);
-    return i + startValue - (float)(searchValue - low_val) / (float)(high_val - low_val);
-  } else {
-    return startValue;
-  }
-}
-//------------------------------------------------------------------------------
-float TableLookup(const unsigned int lookupTable[], unsigned int tableSize, int startValue, unsigned long searchValue) {
-  //simple linear search for now
-  int i;
-  for (i = 0; i < tableSize; i++) {
-    if (searchValue >= pgm_read_word_near(lookupTable + i))
-      break;
-  }
+// LTC2400 status bits, above the data in the first byte of the frame
+#define LTC2400_SIG 0x20 // input above ground
+#define LTC2400_EXR 0x10 // input outside 0 to the reference
+
+// I2C address for MCP3422 - base address for MCP3424
+#define MCP3422_ADDRESS 0X68
+#define MCP342X_I2C_HZ 400000
+#define MCP342X_START      0X80 // write: start a one-shot conversion
+#define MCP342X_BUSY       0X80 // read: output not ready
+#define MCP342X_CHANNEL_1  0X00 // channel field, one-shot mode, PGA x1
+#define MCP342X_RES_FIELD  0X0C // resolution/rate field
+#define MCP342X_12_BIT     0X00 // 12-bit 240 SPS
+#define MCP342X_18_BIT     0X0C // 18-bit 3.75 SPS
+#define MCP342X_FRAME_BYTES 4
+#define MCP342X_DATA_BYTES(config) (((config) & MCP342X_RES_FIELD) == MCP342X_18_BIT ? 3 : 2)
+#define MCP342X_SHIFT_TO_18_BIT(config) (6 - (((config) & MCP342X_RES_FIELD) >> 1)) //12 bit 6 ... 18 bit 0
+
+//lid ADC: channel 1 against AVcc, converted on every Timer0 overflow (976 Hz)
+#define LID_ADC_CHANNEL 1
+#define LID_ADMUX (_BV(REFS0) | LID_ADC_CHANNEL)
+#define LID_ADCSRA (_BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0)) //auto trigger, clk/128
+#define LID_ADCSRB _BV(ADTS2) //trigger source Timer0 overflow
+
+//4^3 samples give 3 extra bits as long as noise dithers the input by a code or so,
+//one decimated block per 65 ms
+#define LID_OVERSAMPLE_BITS 3
+#define LID_OVERSAMPLE_COUNT (1 << (2 * LID_OVERSAMPLE_BITS))
+#define LID_RING_SIZE 4 //power of 2, holds more than one control tick of blocks
+
+struct SLidBlock {
+  uint16_t code;
+  unsigned long timeMs;
+};
+
+//filled by the ADC interrupt, drained by CLidThermistor::ReadTemp
+static volatile SLidBlock sLidRing[LID_RING_SIZE];
+static volatile uint8_t sLidRingHead = 0;
+static uint16_t sLidAccumulator = 0;
+static uint8_t sLidSampleCount = 0;
+
+ISR(ADC_vect) {
+  sLidAccumulator += ADC;
+  if (++sLidSampleCount < LID_OVERSAMPLE_COUNT)
+    return;
   
-  if (i > 0) {
-    unsigned long high_val = pgm_read_word_near(lookupTable + i - 1);
-    unsigned long low_val = pgm_read_word_near(lookupTable + i);
-    return i + startValue - (float)(searchValue - low_val) / (float)(high_val - low_val);
-  } else {
-    return startValue;
-  }
+  volatile SLidBlock& block = sLidRing[sLidRingHead & (LID_RING_SIZE - 1)];
+  block.code = (sLidAccumulator + _BV(LID_OVERSAMPLE_BITS - 1)) >> LID_OVERSAMPLE_BITS;
+  block.timeMs = millis();
+  sLidRingHead++;
+  sLidAccumulator = 0;
+  sLidSampleCount = 0;
 }
 
 ////////////////////////////////////////////////////////////////////
 // Class CLidThermistor
 CLidThermistor::CLidThermistor():
-  iTemp(0.0) {
+  iTemp(0.0),
+  iSampleTimeMs(0),
+  iRingTail(0) {
+  
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    sLidRingHead = 0;
+    sLidAccumulator = 0;
+    sLidSampleCount = 0;
+  }
+  
+  //auto triggered by Timer0, which the core keeps running for millis()
+  DIDR0 |= _BV(LID_ADC_CHANNEL); //digital input buffer off, less noise on the pin
+  ADMUX = LID_ADMUX;
+  ADCSRB = LID_ADCSRB;
+  ADCSRA = LID_ADCSRA;
+}
+//------------------------------------------------------------------------------
+CLidThermistor::~CLidThermistor() {
+  ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
 }
 //------------------------------------------------------------------------------
-void CLidThermistor::ReadTemp() {
-  unsigned long voltage_mv = (unsigned long)analogRead(1) * 5000 / 1024;
-  unsigned long resistance = voltage_mv * 2200 / (5000 - voltage_mv);
+boolean CLidThermistor::ReadTemp() {
+  //average every block decimated since the last read, dropping any the ring overwrote
+  uint16_t codeSum = 0;
+  uint8_t numBlocks;
+  unsigned long timeMs;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    numBlocks = sLidRingHead - iRingTail;
+    if (numBlocks > LID_RING_SIZE) {
+      numBlocks = LID_RING_SIZE;
+      iRingTail = sLidRingHead - LID_RING_SIZE;
+    }
+    for (uint8_t i = 0; i < numBlocks; i++)
+      codeSum += sLidRing[iRingTail++ & (LID_RING_SIZE - 1)].code;
+    timeMs = sLidRing[(sLidRingHead - 1) & (LID_RING_SIZE - 1)].timeMs;
+  }
+  if (numBlocks == 0)
+    return false;
   
-  iTemp = TableLookup(LID_RESISTANCE_TABLE, sizeof(LID_RESISTANCE_TABLE) / sizeof(LID_RESISTANCE_TABLE[0]), 0, resistance);
+  iTemp = LookupTemp<SLidSensor>((codeSum + numBlocks / 2) / numBlocks);
+  iSampleTimeMs = timeMs;
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////
 // Class CPlateThermistor
+#ifdef PLATE_ADC_MCP342X
+CPlateThermistor::CPlateThermistor():
+  iTemp(0.0),
+  iSampleTimeMs(0),
+  iAcquisitionState(EIdle),
+  iFastSampling(false) {
+  
+  Wire.begin();
+  Wire.setClock(MCP342X_I2C_HZ);
+}
+//------------------------------------------------------------------------------
+boolean CPlateThermistor::ReadTemp() {
+  //start: the converter runs on its own, so this returns at once
+  if (iAcquisitionState == EIdle) {
+    StartConversion();
+    return false;
+  }
+  
+  //poll: the configuration byte after the data reports whether the result is ready
+  if (!ReadConversion())
+    return false;
+  
+  //complete: start the next one at the resolution chosen for it
+  StartConversion();
+  iSampleTimeMs = millis();
+  return true;
+}
+//------------------------------------------------------------------------------
+void CPlateThermistor::StartConversion() {
+  Wire.beginTransmission(MCP3422_ADDRESS);
+  Wire.write(MCP342X_START | MCP342X_CHANNEL_1 | (iFastSampling ? MCP342X_12_BIT : MCP342X_18_BIT));
+  iAcquisitionState = Wire.endTransmission() == 0 ? EConverting : EIdle;
+}
+//------------------------------------------------------------------------------
+boolean CPlateThermistor::ReadConversion() {
+  //18 bit results are three data bytes and the configuration, 12 to 16 bit results two data
+  //bytes with the configuration repeated after them, so the last of four is the configuration
+  uint8_t frame[MCP342X_FRAME_BYTES];
+  if (Wire.requestFrom(MCP3422_ADDRESS, MCP342X_FRAME_BYTES) != MCP342X_FRAME_BYTES)
+    return false;
+  for (int i = 0; i < MCP342X_FRAME_BYTES; i++)
+    frame[i] = Wire.read();
+  
+  uint8_t config = frame[MCP342X_FRAME_BYTES - 1];
+  if (config & MCP342X_BUSY)
+    return false;
+  
+  //assembled unsigned, sign extended from the first byte, then scaled to 18 bit by
+  //multiplying, as a reading below zero must not be shifted left
+  uint8_t dataBytes = MCP342X_DATA_BYTES(config);
+  unsigned long code = 0;
+  for (int i = 0; i < dataBytes; i++)
+    code = (code << 8) | frame[i];
+  long conv = (frame[0] & 0x80) ? (long)code - (1L << (8 * dataBytes)) : (long)code;
+  conv *= 1L << MCP342X_SHIFT_TO_18_BIT(config);
+  
+  //below zero the divider is outside its range
+  iTemp = LookupTemp<SPlateSensor>(conv < 0 ? 0 : conv);
+  return true;
+}
+#else
 CPlateThermistor::CPlateThermistor():
-  iTemp(0.0) {
+  iTemp(0.0),
+  iSampleTimeMs(0),
+  iAcquisitionState(EIdle) {
 
   //spi setup
   pinMode(DATAOUT, OUTPUT);
@@ -128,32 +238,39 @@ CPlateThermistor::CPlateThermistor():
   digitalWrite(SLAVESELECT,HIGH); //disable device 
 }
 //------------------------------------------------------------------------------
-void CPlateThermistor::ReadTemp() {
-  digitalWrite(SLAVESELECT, LOW);
+boolean CPlateThermistor::ReadTemp() {
+  //start: select the ADC so it reports end of conversion on DATAIN
+  if (iAcquisitionState == EIdle) {
+    digitalWrite(SLAVESELECT, LOW);
+    iAcquisitionState = EConverting;
+  }
 
-  //read data
-  while(digitalRead(DATAIN)) {}
+  //poll: DATAIN stays high until the conversion is done
+  if (digitalRead(DATAIN))
+    return false;
   
+  //complete: clock out the result, which also starts the next conversion
+  ReadConversion();
+  iAcquisitionState = EIdle;
+  iSampleTimeMs = millis();
+  return true;
+}
+//------------------------------------------------------------------------------
+void CPlateThermistor::ReadConversion() {
   uint8_t spiBuf[4];
   memset(spiBuf, 0, sizeof(spiBuf));
 
-  digitalWrite(SLAVESELECT, LOW);  
   for(int i = 0; i < 4; i++)
     spiBuf[i] = SPITransfer(0xFF);
 
-  unsigned long conv = (((unsigned long)spiBuf[3] >> 7) & 0x01) + ((unsigned long)spiBuf[2] << 1) + ((unsigned long)spiBuf[1] << 9) + (((unsigned long)spiBuf[0] & 0x1F) << 17); //((spiBuf[0] & 0x1F) << 16) + (spiBuf[1] << 8) + spiBuf[2];
-  
-  unsigned long adcDivisor = 0x1FFFFF;
-  float voltage = (float)conv * 5.0 / adcDivisor;
-
-  unsigned int convHigh = (conv >> 16);
+  unsigned long conv = (((unsigned long)spiBuf[3] >> 7) & 0x01) + ((unsigned long)spiBuf[2] << 1) + ((unsigned long)spiBuf[1] << 9) + (((unsigned long)spiBuf[0] & 0x0F) << 17); //((spiBuf[0] & 0x1F) << 16) + (spiBuf[1] << 8) + spiBuf[2];
   
   digitalWrite(SLAVESELECT, HIGH);
   
-  unsigned long voltage_mv = voltage * 1000;
-  unsigned long resistance = voltage_mv * 2200 / (5000 - voltage_mv); // in hecto ohms
- 
-  iTemp = TableLookup(PLATE_RESISTANCE_TABLE, sizeof(PLATE_RESISTANCE_TABLE) / sizeof(PLATE_RESISTANCE_TABLE[0]), -40, resistance);
+  //EXR flags an input past the reference, or below ground when SIG is clear
+  if (spiBuf[0] & LTC2400_EXR)
+    conv = (spiBuf[0] & LTC2400_SIG) ? SPlateSensor::ADC_FULL_SCALE : 0;
+  iTemp = LookupTemp<SPlateSensor>(conv);
 }
 //------------------------------------------------------------------------------
 char CPlateThermistor::SPITransfer(volatile char data) {
@@ -162,3 +279,4 @@ char CPlateThermistor::SPITransfer(volatile char data) {
   {};
   return SPDR;                    // return the received byte
 }
+#endif
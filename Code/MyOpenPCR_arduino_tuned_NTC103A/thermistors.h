@@ -22,23 +22,50 @@
 class CLidThermistor {
 public:
   CLidThermistor();
-  double& GetTemp() { return iTemp; }
-  void ReadTemp();
+  ~CLidThermistor();
+  TTemp& GetTemp() { return iTemp; }
+  unsigned long GetSampleTimeMs() { return iSampleTimeMs; }
+  boolean ReadTemp(); //never blocks, returns true if a new sample was published
   
 private:
-  double iTemp;
+  TTemp iTemp;
+  unsigned long iSampleTimeMs;
+  uint8_t iRingTail;
 };
 
 class CPlateThermistor {
 public:
   CPlateThermistor();
-  double& GetTemp() { return iTemp; }
-  void ReadTemp();
+  TTemp& GetTemp() { return iTemp; }
+  unsigned long GetSampleTimeMs() { return iSampleTimeMs; }
+  boolean ReadTemp(); //never blocks, returns true if a new sample was published
+#ifdef PLATE_ADC_MCP342X
+  void SetFastSampling(boolean fast) { iFastSampling = fast; } //12 bit instead of 18 bit from the next conversion
+#else
+  void SetFastSampling(boolean fast) {} //the LTC2400 has a single rate
+#endif
+  
 private:
-   char SPITransfer(volatile char data);
+  enum TAcquisitionState {
+    EIdle = 0,
+    EConverting
+  };
+  
+#ifdef PLATE_ADC_MCP342X
+  void StartConversion();
+  boolean ReadConversion();
+#else
+  void ReadConversion();
+  char SPITransfer(volatile char data);
+#endif
    
 private:
-  double iTemp;
+  TTemp iTemp;
+  unsigned long iSampleTimeMs;
+  TAcquisitionState iAcquisitionState;
+#ifdef PLATE_ADC_MCP342X
+  boolean iFastSampling;
+#endif
 };
 
 #endif
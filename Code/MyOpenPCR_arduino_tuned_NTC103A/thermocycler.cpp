@@ -22,44 +22,60 @@
 #include "display.h"
 #include "program.h"
 #include "serialcontrol.h"
-#include "../Wire/Wire.h"
+#include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 
 //constants
   
-// I2C address for MCP3422 - base address for MCP3424
-#define MCP3422_ADDRESS 0X68
-#define MCP342X_RES_FIELD  0X0C // resolution/rate field
-#define MCP342X_18_BIT     0X0C // 18-bit 3.75 SPS
-#define MCP342X_BUSY       0X80 // read: output not ready
-
-#define CYCLE_START_TOLERANCE 0.2
-#define LID_START_TOLERANCE 1.0
-
-#define PLATE_PID_INC_NORM_P 3000
-#define PLATE_PID_INC_NORM_I 750
-#define PLATE_PID_INC_NORM_D 3000
-
-#define PLATE_PID_INC_LOW_THRESHOLD 40
-#define PLATE_PID_INC_LOW_P 600
-#define PLATE_PID_INC_LOW_I 200
-#define PLATE_PID_INC_LOW_D 400
-
-#define PLATE_PID_DEC_HIGH_THRESHOLD 70
-#define PLATE_PID_DEC_HIGH_P 800
-#define PLATE_PID_DEC_HIGH_I 700
-#define PLATE_PID_DEC_HIGH_D 300
-
-#define PLATE_PID_DEC_NORM_P 3000
-#define PLATE_PID_DEC_NORM_I 750
-#define PLATE_PID_DEC_NORM_D 3000
-
-#define PLATE_PID_DEC_LOW_THRESHOLD 35
-#define PLATE_PID_DEC_LOW_P 2000
-#define PLATE_PID_DEC_LOW_I 100
-#define PLATE_PID_DEC_LOW_D 200
-
-#define PLATE_BANGBANG_THRESHOLD 2.0
+#define CYCLE_START_TOLERANCE TEMP_C(0.2)
+//boost: the block passes the step by this many times the sample's distance from it,
+//which brings the sample in about four times faster
+#define BOOST_SAMPLE_GAIN 3
+//bounded by the program's overshoot, a share of the ramp, and a few sample time
+//constants after the block reaches the step
+#define MAX_BOOST TEMP_C(5)
+#define BOOST_RAMP_DIVISOR 4
+#define BOOST_TIME_LAGS 2
+#define LID_START_TOLERANCE TEMP_C(1)
+//while the lid heats, the plate stays this far below it so the sample does not
+//condense on the lid
+#define PREHEAT_LID_MARGIN TEMP_C(5)
+//past the first ramp, from room temperature, the fast ramps run so far scale the ramp
+//model's time remaining by up to this factor
+#define ETA_MIN_SCALE_RAMPS 2
+#define ETA_MAX_RAMP_SCALE 4
+//a reset during a long hold loses no more of it than this
+#define CHECKPOINT_INTERVAL_MS 60000
+
+//plate gain schedule points, also where autotune runs its relay experiments
+#define PLATE_GAIN_LOW_TEMP TEMP_C(30)
+#define PLATE_GAIN_NORM_TEMP TEMP_C(55)
+#define PLATE_GAIN_HIGH_TEMP TEMP_C(85)
+
+//plate gains x PID_GAIN_SCALE, per second
+#define PLATE_PID_INC_NORM_P 300000
+#define PLATE_PID_INC_NORM_I 45825
+#define PLATE_PID_INC_NORM_D 24552
+
+#define PLATE_PID_INC_LOW_P 60000
+#define PLATE_PID_INC_LOW_I 12220
+#define PLATE_PID_INC_LOW_D 3274
+
+#define PLATE_PID_DEC_HIGH_P 80000
+#define PLATE_PID_DEC_HIGH_I 42770
+#define PLATE_PID_DEC_HIGH_D 2455
+
+#define PLATE_PID_DEC_NORM_P 300000
+#define PLATE_PID_DEC_NORM_I 45825
+#define PLATE_PID_DEC_NORM_D 24552
+
+#define PLATE_PID_DEC_LOW_THRESHOLD TEMP_C(35)
+#define PLATE_PID_DEC_LOW_P 200000
+#define PLATE_PID_DEC_LOW_I 6110
+#define PLATE_PID_DEC_LOW_D 1637
+
+//the learned feedforward window opens this close to the step temperature
+#define PLATE_SETTLE_THRESHOLD TEMP_C(2)
 
 #define MIN_PELTIER_PWM -1023
 #define MAX_PELTIER_PWM 1023
@@ -69,30 +85,65 @@
 
 #define STARTUP_DELAY 4000
 
+//several missed plate ADC conversions, the converter is not responding
+#define PLATE_SAMPLE_TIMEOUT_MS 1000
+//about 15 lid ADC blocks, the ADC interrupt has stopped
+#define LID_SAMPLE_TIMEOUT_MS 1000
+
 //pid parameters
-const SPIDTuning LID_PID_GAIN_SCHEDULE[] = {
-  //maxTemp, kP, kI, kD
-  { 70, 40, 0.15, 60 },
-  { 200, 80, 1.1, 10 }
+static_assert(CONTROL_TICK_US >= PID_MIN_SAMPLE_US && CONTROL_TICK_US <= PID_MAX_SAMPLE_US, "the PID gain limits assume this sample period");
+#define LID_PID_POINTS 2
+const SPIDTuning LID_PID_GAIN_SCHEDULE[LID_PID_POINTS] = {
+  //temp, kP, kI, kD (x PID_GAIN_SCALE, per second)
+  { TEMP_C(70), 4000, 92, 982 },
+  { TEMP_C(80), 8000, 672, 164 }
+};
+
+//until an autotune run stores a schedule in EEPROM
+const SPlateGainSchedule DEFAULT_PLATE_GAINS PROGMEM = {
+  { //heating: temp, kP, kI, kD
+    { PLATE_GAIN_LOW_TEMP, PLATE_PID_INC_LOW_P, PLATE_PID_INC_LOW_I, PLATE_PID_INC_LOW_D },
+    { PLATE_GAIN_NORM_TEMP, PLATE_PID_INC_NORM_P, PLATE_PID_INC_NORM_I, PLATE_PID_INC_NORM_D },
+    { PLATE_GAIN_HIGH_TEMP, PLATE_PID_INC_NORM_P, PLATE_PID_INC_NORM_I, PLATE_PID_INC_NORM_D }
+  },
+  { //cooling
+    { PLATE_GAIN_LOW_TEMP, PLATE_PID_DEC_LOW_P, PLATE_PID_DEC_LOW_I, PLATE_PID_DEC_LOW_D },
+    { PLATE_GAIN_NORM_TEMP, PLATE_PID_DEC_NORM_P, PLATE_PID_DEC_NORM_I, PLATE_PID_DEC_NORM_D },
+    { PLATE_GAIN_HIGH_TEMP, PLATE_PID_DEC_HIGH_P, PLATE_PID_DEC_HIGH_I, PLATE_PID_DEC_HIGH_D }
+  }
 };
 
 //public
 Thermocycler::Thermocycler(boolean restarted):
-  iRestarted(restarted),
   ipDisplay(NULL),
-  ipProgram(NULL),
-  ipDisplayCycle(NULL),
   ipSerialControl(NULL),
   iProgramState(EStartup),
+  iErrorStatus(ESuccess),
+  iTargetLidTemp(0),
+  ipProgram(NULL),
   ipPreviousStep(NULL),
   ipCurrentStep(NULL),
-  iThermalDirection(OFF),
-  iPeltierPwm(0),
   iCycleStartTime(0),
   iRamping(true),
-  iPlatePid(&iPlateThermistor.GetTemp(), &iPeltierPwm, &iTargetPlateTemp, PLATE_PID_INC_NORM_P, PLATE_PID_INC_NORM_I, PLATE_PID_INC_NORM_D, DIRECT),
-  iLidPid(LID_PID_GAIN_SCHEDULE, MIN_LID_PWM, MAX_LID_PWM),
-  iTargetLidTemp(0) {
+  iRestarted(restarted),
+  iSampleHold(false),
+  iMaxBlockOvershoot(0),
+  iPreheatTemp(0),
+  iPreheatStartTemp(0),
+  iResuming(false),
+  iResumeElapsedS(0),
+  iHoldCreditS(0),
+  iCheckpointTimeMs(0),
+  iBoost(0),
+  iPlateControlMode(ETrajectory),
+  iPlateTrajectory(MAX_PELTIER_PWM),
+  iPlatePid(iPlateGains.heating, iPlateGains.cooling, PLATE_GAIN_BANDS, MIN_PELTIER_PWM, MAX_PELTIER_PWM, CONTROL_TICK_US),
+  iPlateAutotune(MIN_PELTIER_PWM, MAX_PELTIER_PWM),
+  iPlateLearning(MIN_PELTIER_PWM, MAX_PELTIER_PWM),
+  iLidPid(LID_PID_GAIN_SCHEDULE, LID_PID_GAIN_SCHEDULE, LID_PID_POINTS, MIN_LID_PWM, MAX_LID_PWM, CONTROL_TICK_US),
+  iThermalDirection(OFF),
+  iPeltierPwm(0),
+  iControlSuspendCount(0) {
     
   ipDisplay = new Display();
   ipSerialControl = new SerialControl(ipDisplay);
@@ -111,9 +162,12 @@ Thermocycler::Thermocycler(boolean restarted):
   SPCR = (1<<SPE)|(1<<MSTR)|(1<<4);
   clr=SPSR;
   clr=SPDR;
+  (void)clr; //read only to clear the flags
   delay(10); 
 
-  iPlatePid.SetOutputLimits(MIN_PELTIER_PWM, MAX_PELTIER_PWM);
+  LoadPlateGains();
+  if (!ProgramStore::RetrieveRampModel(iRampModel.GetModel()))
+    iRampModel.Reset();
   
   // Peltier PWM
   TCCR1A |= (1<<WGM11) | (1<<WGM10);
@@ -124,26 +178,65 @@ Thermocycler::Thermocycler(boolean restarted):
   TCCR2B = _BV(CS22);
 
   iszProgName[0] = '\0';
+  
+  // Control tick
+  TIMSK1 |= _BV(TOIE1);
+  
+  iProgram.AllocateArena(); //last, it takes what the heap has left
 }
 
 Thermocycler::~Thermocycler() {
+  TIMSK1 &= ~_BV(TOIE1);
   delete ipSerialControl;
   delete ipDisplay;
 }
 
 // accessors
+int Thermocycler::GetPeltierPwm() {
+  int pwm;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    pwm = iPeltierPwm;
+  }
+  return pwm;
+}
+
+TTemp Thermocycler::GetLidTemp() {
+  TTemp temp;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    temp = iLidThermistor.GetTemp();
+  }
+  return temp;
+}
+
+TTemp Thermocycler::GetPlateTemp() {
+  TTemp temp;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    temp = iPlateEstimator.GetBlockTemp();
+  }
+  return temp;
+}
+
+TTemp Thermocycler::GetSampleTemp() {
+  TTemp temp;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    temp = iPlateEstimator.GetSampleTemp();
+  }
+  return temp;
+}
+
 int Thermocycler::GetNumCycles() {
-  return ipDisplayCycle->GetNumCycles();
+  return iProgram.GetNumCycles();
 }
 
 int Thermocycler::GetCurrentCycleNum() {
-  int numCycles = GetNumCycles();
-  return ipDisplayCycle->GetCurrentCycle() > numCycles ? numCycles : ipDisplayCycle->GetCurrentCycle();
+  return iProgram.GetCurrentCycle();
 }
 
 Thermocycler::ThermalState Thermocycler::GetThermalState() {
-  if (iProgramState == EStartup || iProgramState == EStopped)
+  if (iProgramState == EStartup || iProgramState == EStopped || iProgramState == EError)
     return EIdle;
+  if (iProgramState == EComplete && ipCurrentStep == NULL)
+    return EIdle; //past a last step that was not a final hold
   
   if (iRamping) {
     if (ipPreviousStep != NULL) {
@@ -157,26 +250,31 @@ Thermocycler::ThermalState Thermocycler::GetThermalState() {
 }
  
 // control
-void Thermocycler::SetProgram(Cycle* pProgram, Cycle* pDisplayCycle, const char* szProgName, int lidTemp) {
+void Thermocycler::SetProgram(Program* pProgram, const char* szProgName, int lidTemp,
+                              int sampleVolumeUl, TTemp maxBlockOvershoot, TTemp preheatTemp) {
   Stop();
 
   ipProgram = pProgram;
-  ipDisplayCycle = pDisplayCycle;
 
   strcpy(iszProgName, szProgName);
-  iTargetLidTemp = lidTemp;
+  iTargetLidTemp = TEMP_C(lidTemp);
+  
+  //with the sample volume known, holds start when the sample reaches the step
+  iPlateEstimator.SetSampleVolume(sampleVolumeUl);
+  iSampleHold = sampleVolumeUl > 0;
+  iMaxBlockOvershoot = constrain(maxBlockOvershoot, 0, MAX_BOOST);
+  iPreheatTemp = preheatTemp;
 }
 
 void Thermocycler::Stop() {
+  if (iProgramState == EAutotune)
+    LoadPlateGains(); //drops the bands tuned so far
   iProgramState = EStopped;
   
   ipProgram = NULL;
   ipPreviousStep = NULL;
   ipCurrentStep = NULL;
   
-  iStepPool.ResetPool();
-  iCyclePool.ResetPool();
-  
   ipDisplay->Clear();
 }
 
@@ -184,86 +282,171 @@ PcrStatus Thermocycler::Start() {
   if (ipProgram == NULL)
     return ENoProgram;
   
-  //advance to lid wait state
+  //advance to lid wait state, the plate preheating no further than the first step
+  SuspendControl();
+  if (iPreheatTemp != 0) {
+    if (ipProgram->GetNumSteps() > 0 && ipProgram->GetStep(0)->GetTemp() < iPreheatTemp)
+      iPreheatTemp = ipProgram->GetStep(0)->GetTemp();
+    
+    iPreheatStartTemp = GetPlateTemp();
+    iPlatePid.SetCooling(iPreheatTemp < iPreheatStartTemp);
+    iPlateTrajectory.SetRateLimit(0, 0);
+    iPlateTrajectory.Reset(iPreheatStartTemp);
+    iPlatePid.Reset(iPreheatStartTemp, 0);
+  }
   iProgramState = ELidWait;
+  ResumeControl();
+  
+  //from the top, a checkpoint of an earlier run no longer applies
+  iResuming = false;
+  iHoldCreditS = 0;
+  ProgramStore::ClearCheckpoint();
+  
+  return ESuccess;
+}
+
+void Thermocycler::Resume(SRunCheckpoint& checkpoint) {
+  if (iProgramState != ELidWait || !ipProgram->SeekStep(checkpoint.stepIndex, checkpoint.cycleIndex))
+    return;
+  
+  //the step ramps from wherever the block cooled to, then holds for what is left
+  iResuming = true;
+  iResumeElapsedS = checkpoint.elapsedS;
+  iHoldCreditS = checkpoint.holdS;
+  ProgramStore::StoreCheckpoint(checkpoint); //over the one Start cleared
+}
+
+PcrStatus Thermocycler::StartAutotune() {
+  Stop();
+  
+  iPlateAutotune.Start(&iPlateGains);
+  iProgramState = EAutotune;
   
   return ESuccess;
 }
     
 // internal
 void Thermocycler::Loop() {
+  //program state changes must not interleave with the control tick; the end of a run
+  //is stored once it runs again, so the synchronous ramp model write does not hold it up
+  boolean completed = false;
+  SuspendControl();
+  
   switch (iProgramState) {
   case EStartup:
     if (millis() > STARTUP_DELAY) {
       iProgramState = EStopped;
       
-      if (!iRestarted && !ipSerialControl->CommandReceived()) {
-        //check for stored program
+      if (!ipSerialControl->CommandReceived()) {
+        //check for stored program, restarted at power up and resumed after any reset
+        //that left a run of it unfinished
         SCommand command;
-        if (ProgramStore::RetrieveProgram(command, (char*)ipSerialControl->GetBuffer()))
-          ProcessCommand(command);
+        SRunCheckpoint checkpoint;
+        if (ProgramStore::RetrieveProgram(command, (char*)ipSerialControl->GetBuffer())) {
+          boolean resume = ProgramStore::RetrieveCheckpoint(checkpoint);
+          if (resume || !iRestarted) {
+            ProcessCommand(command);
+            if (resume)
+              Resume(checkpoint);
+          }
+        }
       }
     }
     break;
 
   case ELidWait:    
     if (GetLidTemp() >= iTargetLidTemp - LID_START_TOLERANCE) {
-      //lid has warmed, begin program
-      iThermalDirection = OFF;
-      iPeltierPwm = 0;
+      //lid has warmed, begin program, the plate continuing from any preheat drive
+      if (iPreheatTemp == 0) {
+        iThermalDirection = OFF;
+        iPeltierPwm = 0;
+      }
       PreprocessProgram();
+      iPlateTrajectory.Reset(GetPlateTemp());
+      iPlatePid.Reset(GetPlateTemp(), iPeltierPwm);
       iProgramState = ERunning;
       
-      ipProgram->BeginIteration();
-      AdvanceToNextStep();
-      
       iProgramStartTimeMs = millis();
+      if (iResuming) {
+        iProgramStartTimeMs -= iResumeElapsedS * 1000;
+        iResuming = false;
+      } else {
+        ipProgram->BeginIteration();
+      }
+      AdvanceToNextStep();
     }
     break;
   
   case ERunning:
     //update program
     if (iProgramState == ERunning) {
-      if (iRamping && abs(ipCurrentStep->GetTemp() - GetPlateTemp()) <= CYCLE_START_TOLERANCE && GetRampElapsedTimeMs() > ipCurrentStep->GetRampDurationS() * 1000) {
+      if (iRamping)
+        iRampModel.Update(GetPlateTemp());
+      
+      if (iRamping && abs(ipCurrentStep->GetTemp() - GetHoldTemp()) <= CYCLE_START_TOLERANCE && GetRampElapsedTimeMs() > ipCurrentStep->GetRampDurationS() * 1000) {
         //begin step hold
         
         //eta updates
         if (ipCurrentStep->GetRampDurationS() == 0) {
-          //fast ramp
-          iElapsedFastRampDegrees += absf(GetPlateTemp() - iRampStartTemp);
+          //fast ramp, against what PreprocessProgram predicted for it
+          TTemp previousTemp = ipPreviousStep ? ipPreviousStep->GetTemp() : iRampStartTemp;
+          iElapsedFastRampPredictedMs += iRampModel.PredictMs(previousTemp, ipCurrentStep->GetTemp());
           iTotalElapsedFastRampDurationMs += millis() - iRampStartTime;
+          iRampModel.EndRamp();
         }
         
-        if (iRampStartTemp > GetPlateTemp())
-          iHasCooled = true;
         iRamping = false;
-        iCycleStartTime = millis();
+        iCycleStartTime = millis() - iHoldCreditS * 1000UL;
+        iHoldCreditS = 0;
         
       } else if (!iRamping && !ipCurrentStep->IsFinal() && millis() - iCycleStartTime > (unsigned long)ipCurrentStep->GetStepDurationS() * 1000) {
         //begin next step
         AdvanceToNextStep();
           
-        //check for program completion
-        if (ipCurrentStep == NULL || ipCurrentStep->IsFinal())
-          iProgramState = EComplete;        
+        //check for program completion, keeping what the ramps taught the ramp model
+        if (ipCurrentStep == NULL || ipCurrentStep->IsFinal()) {
+          iProgramState = EComplete;
+          iRampModel.EndRun();
+          completed = true;
+        }
+        
+      } else if (!iRamping && millis() - iCheckpointTimeMs >= CHECKPOINT_INTERVAL_MS) {
+        WriteCheckpoint();
       }
     }
     break;
     
   case EComplete:
-    if (iRamping && ipCurrentStep != NULL && abs(ipCurrentStep->GetTemp() - GetPlateTemp()) <= CYCLE_START_TOLERANCE)
+    if (iRamping && ipCurrentStep != NULL && abs(ipCurrentStep->GetTemp() - GetHoldTemp()) <= CYCLE_START_TOLERANCE)
       iRamping = false;
     break;
+    
+  case EAutotune:
+    if (!iPlateAutotune.Running()) {
+      if (SUCCEEDED(iPlateAutotune.GetStatus())) {
+        ProgramStore::StorePlateGains(iPlateGains);
+        LoadPlateGains();
+        iProgramState = EStopped;
+      } else {
+        LoadPlateGains();
+        iErrorStatus = iPlateAutotune.GetStatus();
+        iProgramState = EError;
+      }
+    }
+    break;
+    
+  case EStopped:
+  case EError:
+  case EClear:
+    break;
   }
   
-  //lid 
-  iLidThermistor.ReadTemp();
-  ControlLid();
+  ResumeControl();
   
-  //plate  
-  iPlateThermistor.ReadTemp();
-  CalcPlateTarget();
-  ControlPeltier();
+  if (completed) {
+    ProgramStore::StoreRampModel(iRampModel.GetModel());
+    ProgramStore::ClearCheckpoint();
+  }
   
   //program
   UpdateEta();
@@ -271,8 +454,66 @@ void Thermocycler::Loop() {
   ipSerialControl->Process();
 }
 
+//ControlTick runs at a fixed rate from the timer interrupt, so plate and lid
+//sample periods no longer depend on display and serial work in Loop()
+void Thermocycler::ControlTick() {
+  //lid, heater off if the ADC interrupt stops delivering samples
+  iLidThermistor.ReadTemp();
+  if (millis() - iLidThermistor.GetSampleTimeMs() < LID_SAMPLE_TIMEOUT_MS)
+    ControlLid();
+  else
+    analogWrite(3, 0);
+  
+  //plate, never waits for the converter; fast low resolution samples while ramping
+  iPlateThermistor.SetFastSampling(iRamping);
+  boolean newSample = iPlateThermistor.ReadTemp();
+  iPlateEstimator.Update(iThermalDirection == OFF ? 0 : iPeltierPwm, iPlateThermistor.GetTemp(), newSample);
+  iPlateTrajectory.Observe(iThermalDirection == OFF ? 0 : iPeltierPwm, iPlateEstimator.GetBlockTemp());
+  CalcPlateTarget();
+  if (millis() - iPlateThermistor.GetSampleTimeMs() < PLATE_SAMPLE_TIMEOUT_MS) {
+    ControlPeltier();
+  } else {
+    iThermalDirection = OFF;
+    SetPeltier(OFF, 0);
+  }
+}
+
+//masks the control tick only, so millis() and serial keep running
+void Thermocycler::SuspendControl() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    iControlSuspendCount++;
+    TIMSK1 &= ~_BV(TOIE1);
+  }
+}
+
+void Thermocycler::ResumeControl() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (iControlSuspendCount > 0 && --iControlSuspendCount == 0)
+      TIMSK1 |= _BV(TOIE1);
+  }
+}
+
+ISR(TIMER1_OVF_vect) {
+  static uint8_t overflows = 0;
+  static boolean inTick = false;
+  
+  if (overflows < CONTROL_TICK_OVERFLOWS)
+    overflows++;
+  if (overflows < CONTROL_TICK_OVERFLOWS || inTick || gpThermocycler == NULL)
+    return;
+  overflows = 0;
+  
+  //allow millis() and serial interrupts while the control path runs
+  inTick = true;
+  sei();
+  GetThermocycler().ControlTick();
+  cli();
+  inTick = false;
+}
+
 //private
 void Thermocycler::AdvanceToNextStep() {
+  iPlateLearning.EndTransition();
   ipPreviousStep = ipCurrentStep;
   ipCurrentStep = ipProgram->GetNextStep();
   if (ipCurrentStep == NULL)
@@ -283,95 +524,121 @@ void Thermocycler::AdvanceToNextStep() {
     iRamping = true;
     iRampStartTime = millis();
     iRampStartTemp = GetPlateTemp();
+    if (ipCurrentStep->GetRampDurationS() == 0 && !ipCurrentStep->IsFinal())
+      iRampModel.BeginRamp(iRampStartTemp, ipCurrentStep->GetTemp());
+    
+    iBoost = abs(ipCurrentStep->GetTemp() - iRampStartTemp) / BOOST_RAMP_DIVISOR;
+    if (iBoost > iMaxBlockOvershoot)
+      iBoost = iMaxBlockOvershoot;
+    iBoostTicks = iPlateEstimator.GetSampleLagTicks() * BOOST_TIME_LAGS;
+    iBoostStarted = false;
   } else {
     iCycleStartTime = millis(); //next step starts immediately
   }
   
-  CalcPlateTarget();
   SetPlateControlStrategy();
+  if (!ipCurrentStep->IsFinal())
+    WriteCheckpoint();
 }
 
 void Thermocycler::SetPlateControlStrategy() {
-  if (InControlledRamp())
-    return;
-    
-  if (absf(iTargetPlateTemp - GetPlateTemp()) >= PLATE_BANGBANG_THRESHOLD && !InControlledRamp()) {
-    iPlateControlMode = EBangBang;
-    iPlatePid.SetMode(MANUAL);
+  if (abs(ipCurrentStep->GetTemp() - GetPlateTemp()) >= PLATE_SETTLE_THRESHOLD) {
+    iPlateControlMode = ETrajectory;
   } else {
     iPlateControlMode = EPIDPlate;
-    iPlatePid.SetMode(AUTOMATIC);
+    if (iRamping)
+      iPlateLearning.BeginTransition(ipPreviousStep, ipCurrentStep);
   }
   
   if (iRamping) {
-    if (iTargetPlateTemp >= GetPlateTemp()) {
-      iDecreasing = false;
-      if (iTargetPlateTemp < PLATE_PID_INC_LOW_THRESHOLD)
-        iPlatePid.SetTunings(PLATE_PID_INC_LOW_P, PLATE_PID_INC_LOW_I, PLATE_PID_INC_LOW_D);
-      else
-        iPlatePid.SetTunings(PLATE_PID_INC_NORM_P, PLATE_PID_INC_NORM_I, PLATE_PID_INC_NORM_D);
-
-    } else {
-      iDecreasing = true;
-      if (iTargetPlateTemp > PLATE_PID_DEC_HIGH_THRESHOLD)
-        iPlatePid.SetTunings(PLATE_PID_DEC_HIGH_P, PLATE_PID_DEC_HIGH_I, PLATE_PID_DEC_HIGH_D);
-      else if (iTargetPlateTemp < PLATE_PID_DEC_LOW_THRESHOLD)
-        iPlatePid.SetTunings(PLATE_PID_DEC_LOW_P, PLATE_PID_DEC_LOW_I, PLATE_PID_DEC_LOW_D);
-      else
-        iPlatePid.SetTunings(PLATE_PID_DEC_NORM_P, PLATE_PID_DEC_NORM_I, PLATE_PID_DEC_NORM_D);
-    }
+    iDecreasing = ipCurrentStep->GetTemp() < GetPlateTemp();
+    iPlatePid.SetCooling(iDecreasing);
+    
+    //controlled ramp at its set rate, fast ramp as fast as the Peltier allows
+    if (InControlledRamp())
+      iPlateTrajectory.SetRateLimit(ipCurrentStep->GetTemp() - ipPreviousStep->GetTemp(), ipCurrentStep->GetRampDurationS());
+    else
+      iPlateTrajectory.SetRateLimit(0, 0);
   }
 }
 
+TTemp Thermocycler::GetHoldTemp() {
+  return iSampleHold ? GetSampleTemp() : GetPlateTemp();
+}
+
+void Thermocycler::LoadPlateGains() {
+  if (!ProgramStore::RetrievePlateGains(iPlateGains) || !CPlateAutotune::IsValidSchedule(iPlateGains))
+    memcpy_P(&iPlateGains, &DEFAULT_PLATE_GAINS, sizeof(iPlateGains));
+  iPlatePid.SetGainSchedule(iPlateGains.heating, iPlateGains.cooling);
+}
+
 void Thermocycler::CalcPlateTarget() {
+  if (iProgramState == ELidWait && iPreheatTemp != 0) {
+    //follows the lid up to the preheat temperature; cooling is safe at once
+    TTemp lowest = iPreheatTemp < iPreheatStartTemp ? iPreheatTemp : iPreheatStartTemp;
+    iBlockTarget = constrain(GetLidTemp() - PREHEAT_LID_MARGIN, lowest, iPreheatTemp);
+    iPlateTrajectory.Update(iBlockTarget, GetPlateTemp());
+    iTargetPlateTemp = iPlateTrajectory.GetReference();
+    return;
+  }
   if (ipCurrentStep == NULL)
     return;
   
-  if (InControlledRamp()) {
-    //controlled ramp
-    double tempDelta = ipCurrentStep->GetTemp() - ipPreviousStep->GetTemp();
-    double rampPoint = (double)GetRampElapsedTimeMs() / (ipCurrentStep->GetRampDurationS() * 1000);
-    iTargetPlateTemp = ipPreviousStep->GetTemp() + tempDelta * rampPoint;
+  //the step temperature, passed while the sample still lags behind the block
+  TTemp stepTemp = ipCurrentStep->GetTemp();
+  iBlockTarget = stepTemp;
+  if (iBoost > 0) {
+    boolean heating = stepTemp > iRampStartTemp;
+    if (heating ? GetPlateTemp() >= stepTemp : GetPlateTemp() <= stepTemp)
+      iBoostStarted = true;
+    if (iBoostStarted && --iBoostTicks == 0)
+      iBoost = 0;
     
-  } else {
-    //fast ramp
-    iTargetPlateTemp = ipCurrentStep->GetTemp();
+    long overshoot = (long)(heating ? stepTemp - GetSampleTemp() : GetSampleTemp() - stepTemp) * BOOST_SAMPLE_GAIN;
+    overshoot = constrain(overshoot, 0, iBoost);
+    iBlockTarget = heating ? stepTemp + overshoot : stepTemp - overshoot;
   }
+  
+  iPlateTrajectory.Update(iBlockTarget, GetPlateTemp());
+  iTargetPlateTemp = iPlateTrajectory.GetReference();
 }
 
 void Thermocycler::ControlPeltier() {
   ThermalDirection newDirection = OFF;
   
   if (iProgramState == ERunning || (iProgramState == EComplete && ipCurrentStep != NULL)) {
-    // Check whether we are nearing target and should switch to PID control
-    if (iPlateControlMode == EBangBang && absf(iTargetPlateTemp - GetPlateTemp()) < PLATE_BANGBANG_THRESHOLD) {
+    // Check whether we are nearing the block target and the learned window opens
+    if (iPlateControlMode == ETrajectory && abs(iBlockTarget - GetPlateTemp()) < PLATE_SETTLE_THRESHOLD) {
       iPlateControlMode = EPIDPlate;
-      iPlatePid.SetMode(AUTOMATIC);
-      iPlatePid.ResetI();
+      iPlateLearning.BeginTransition(ipPreviousStep, ipCurrentStep);
     }
  
-    // Apply control mode
-    if (iPlateControlMode == EBangBang)
-      iPeltierPwm = iTargetPlateTemp > GetPlateTemp() ? MAX_PELTIER_PWM : MIN_PELTIER_PWM;
-    iPlatePid.Compute();
+    // Track the planned reference, with the drive it needs
+    iPeltierPwm = iPlatePid.Compute(iTargetPlateTemp, GetPlateTemp(), iPlateTrajectory.GetRate(), iPlateTrajectory.GetFeedforward());
+    if (iPlateControlMode == EPIDPlate)
+      iPeltierPwm = iPlateLearning.Apply(iPeltierPwm, iBlockTarget - GetPlateTemp());
     
     if (iDecreasing && iTargetPlateTemp > PLATE_PID_DEC_LOW_THRESHOLD) {
       if (iTargetPlateTemp < GetPlateTemp())
-        iPlatePid.ResetI();
+        iPlatePid.ResetIntegrator();
       else
         iDecreasing = false;
     } 
-    
-    if (iPeltierPwm > 0)
-      newDirection = HEAT;
-    else if (iPeltierPwm < 0)
-      newDirection = COOL; 
-    else
-      newDirection = OFF;
+  } else if (iProgramState == ELidWait && iPreheatTemp != 0) {
+    iPeltierPwm = iPlatePid.Compute(iTargetPlateTemp, GetPlateTemp(), iPlateTrajectory.GetRate(), iPlateTrajectory.GetFeedforward());
+  } else if (iProgramState == EAutotune) {
+    iPeltierPwm = iPlateAutotune.Compute(iPlateThermistor.GetTemp()); //the real block and sensor lag, not the model
   } else {
     iPeltierPwm = 0;
   }
   
+  if (iPeltierPwm > 0)
+    newDirection = HEAT;
+  else if (iPeltierPwm < 0)
+    newDirection = COOL; 
+  else
+    newDirection = OFF;
+  
   iThermalDirection = newDirection;
   SetPeltier(newDirection, abs(iPeltierPwm));
 }
@@ -386,57 +653,88 @@ void Thermocycler::ControlLid() {
 
 //PreprocessProgram initializes ETA parameters and validates/modifies ramp conditions
 void Thermocycler::PreprocessProgram() {
-  Step* pCurrentStep;
-  Step* pPreviousStep = NULL;
-  
+  iPlateLearning.Reset();
   iProgramHoldDurationS = 0;
   iEstimatedTimeRemainingS = 0;
-  iHasCooled = false;
   
   iProgramControlledRampDurationS = 0;
-  iProgramFastRampDegrees = 0;
-  iElapsedFastRampDegrees = 0;
-  iTotalElapsedFastRampDurationMs = 0;  
+  iRampModel.BeginRun();
+  iProgramFastRampMs = 0;
+  iElapsedFastRampPredictedMs = 0;
+  iTotalElapsedFastRampDurationMs = 0;
   
-  ipProgram->BeginIteration();
-  while ((pCurrentStep = ipProgram->GetNextStep()) && !pCurrentStep->IsFinal()) {
+  //the first cycle of each loop follows the loop before it, the repeats all follow its
+  //own last step, so they are the same and counted together
+  Step* pPreviousStep = NULL;
+  for (int i = 0; i < ipProgram->GetNumLoops(); i++) {
+    const SProgramLoop& loop = ipProgram->GetLoop(i);
+    if (!PreprocessSteps(loop, pPreviousStep, 1))
+      return;
+    
+    pPreviousStep = ipProgram->GetStep(loop.endStep - 1);
+    if (loop.numCycles > 1 && !PreprocessSteps(loop, pPreviousStep, loop.numCycles - 1))
+      return;
+  }
+}
+
+//PreprocessSteps adds passes cycles of the loop, false once it reaches the final step
+boolean Thermocycler::PreprocessSteps(const SProgramLoop& loop, Step* pPreviousStep, int passes) {
+  for (int i = loop.firstStep; i < loop.endStep; i++) {
+    Step* pCurrentStep = ipProgram->GetStep(i);
+    if (pCurrentStep->IsFinal())
+      return false;
+    
     //validate ramp
-    if (pPreviousStep != NULL && pCurrentStep->GetRampDurationS() * 1000 < absf(pCurrentStep->GetTemp() - pPreviousStep->GetTemp()) * PLATE_FAST_RAMP_THRESHOLD_MS) {
+    if (pPreviousStep != NULL && pCurrentStep->GetRampDurationS() * 1000 < abs(pCurrentStep->GetTemp() - pPreviousStep->GetTemp()) * (unsigned long)PLATE_FAST_RAMP_THRESHOLD_MS / TEMP_SCALE) {
       //cannot ramp that fast, ignored set ramp
       pCurrentStep->SetRampDurationS(0);
     }
     
     //update eta hold
-    iProgramHoldDurationS += pCurrentStep->GetStepDurationS();
+    iProgramHoldDurationS += (unsigned long)pCurrentStep->GetStepDurationS() * passes;
  
     //update eta ramp
     if (pCurrentStep->GetRampDurationS() > 0) {
       //controlled ramp
-      iProgramControlledRampDurationS += pCurrentStep->GetRampDurationS();
+      iProgramControlledRampDurationS += pCurrentStep->GetRampDurationS() * passes;
     } else {
       //fast ramp
-      double previousTemp = pPreviousStep ? pPreviousStep->GetTemp() : GetPlateTemp();
-      iProgramFastRampDegrees += absf(previousTemp - pCurrentStep->GetTemp()) - CYCLE_START_TOLERANCE;
+      TTemp previousTemp = pPreviousStep ? pPreviousStep->GetTemp() : GetPlateTemp();
+      iProgramFastRampMs += iRampModel.PredictMs(previousTemp, pCurrentStep->GetTemp()) * passes;
     }
     
     pPreviousStep = pCurrentStep;
   }
+  
+  return true;
 }
 
 void Thermocycler::UpdateEta() {
   if (iProgramState == ERunning) {
-    double fastSecondPerDegree;
-    if (iElapsedFastRampDegrees == 0 || !iHasCooled)
-      fastSecondPerDegree = 1.0;
-    else
-      fastSecondPerDegree = iTotalElapsedFastRampDurationMs / 1000 / iElapsedFastRampDegrees;
-      
-    unsigned long estimatedDurationS = iProgramHoldDurationS + iProgramControlledRampDurationS + iProgramFastRampDegrees * fastSecondPerDegree;
+    //fast ramps as the ramp model predicts them, scaled in 1/256 by how the ramps so far
+    //compare to it, which covers a warmer room or a tired Peltier
+    unsigned long fastRampS = iProgramFastRampMs / 1000;
+    if (iRampModel.GetNumRamps() >= ETA_MIN_SCALE_RAMPS && iElapsedFastRampPredictedMs > 0) {
+      unsigned long scale = (iTotalElapsedFastRampDurationMs << 8) / iElapsedFastRampPredictedMs;
+      scale = constrain(scale, 256 / ETA_MAX_RAMP_SCALE, 256 * ETA_MAX_RAMP_SCALE);
+      fastRampS = fastRampS * scale >> 8;
+    }
+    unsigned long estimatedDurationS = iProgramHoldDurationS + iProgramControlledRampDurationS + fastRampS;
     unsigned long elapsedTimeS = GetElapsedTimeS();
     iEstimatedTimeRemainingS = estimatedDurationS > elapsedTimeS ? estimatedDurationS - elapsedTimeS : 0;
   }
 }
 
+void Thermocycler::WriteCheckpoint() {
+  SRunCheckpoint checkpoint;
+  checkpoint.elapsedS = GetElapsedTimeS();
+  checkpoint.stepIndex = ipProgram->GetStepIndex();
+  checkpoint.cycleIndex = ipProgram->GetCycleIndex();
+  checkpoint.holdS = iRamping ? iHoldCreditS : (millis() - iCycleStartTime) / 1000;
+  ProgramStore::StoreCheckpoint(checkpoint);
+  iCheckpointTimeMs = millis();
+}
+
 void Thermocycler::SetPeltier(ThermalDirection dir, int pwm) {
   if (dir == COOL) {
     digitalWrite(2, HIGH);
@@ -453,25 +751,35 @@ void Thermocycler::SetPeltier(ThermalDirection dir, int pwm) {
 }
 
 void Thermocycler::ProcessCommand(SCommand& command) {
-  if (command.command == SCommand::EStart) {
-    //find display cycle
-    Cycle* pProgram = command.pProgram;
-    Cycle* pDisplayCycle = pProgram;
-    int largestCycleCount = 0;
-    
-    for (int i = 0; i < pProgram->GetNumComponents(); i++) {
-      ProgramComponent* pComp = pProgram->GetComponent(i);
-      if (pComp->GetType() == ProgramComponent::ECycle) {
-        Cycle* pCycle = (Cycle*)pComp;
-        if (pCycle->GetNumCycles() > largestCycleCount) {
-          largestCycleCount = pCycle->GetNumCycles();
-          pDisplayCycle = pCycle;
-        }
-      }
+  if (command.command == SCommand::ERun) {
+    //the program and its settings come from the library slot
+    command.pProgram = &iProgram;
+    command.status = ProgramStore::RetrieveSlot(command);
+  }
+  
+  if (command.command == SCommand::EStart || command.command == SCommand::ERun) {
+    if (SUCCEEDED(command.status)) {
+      GetThermocycler().SetProgram(command.pProgram, command.name, command.lidTemp,
+                                   command.sampleVolume, command.maxBlockOvershoot, command.preheatTemp);
+      GetThermocycler().Start();
+    } else {
+      //a program that does not parse or fit is refused whole
+      Stop();
+      iErrorStatus = command.status;
+      iProgramState = EError;
     }
     
-    GetThermocycler().SetProgram(pProgram, pDisplayCycle, command.name, command.lidTemp);
-    GetThermocycler().Start();
+  } else if (command.command == SCommand::EAutotune) {
+    StartAutotune();
+    
+  } else if (command.command == SCommand::ESave) {
+    //compiled like a start command, then kept in the library slot instead of run; as
+    //with any command, a program that was running stopped when parsing began
+    PcrStatus status = SUCCEEDED(command.status) ? ProgramStore::StoreSlot(command) : command.status;
+    if (!SUCCEEDED(status)) {
+      iErrorStatus = status;
+      iProgramState = EError;
+    }
     
   } else if (command.command == SCommand::EStop) {
     GetThermocycler().Stop(); //redundant as we already stopped during parsing
@@ -19,10 +19,16 @@
 #ifndef _THERMOCYCLER_H_
 #define _THERMOCYCLER_H_
 
-#include "PID_v1.h"
+#include <util/atomic.h>
+
 #include "pid.h"
+#include "autotune.h"
+#include "estimator.h"
+#include "learning.h"
 #include "program.h"
+#include "rampmodel.h"
 #include "thermistors.h"
+#include "trajectory.h"
 
 class Display;
 class SerialControl;
@@ -36,6 +42,7 @@ public:
     ERunning,
     EComplete,
     EError,
+    EAutotune,
     EClear //for Display clearing only
   };
   
@@ -53,7 +60,7 @@ public:
   };
   
   enum ControlMode {
-    EBangBang,
+    ETrajectory,
     EPIDLid,
     EPIDPlate
   };
@@ -63,33 +70,39 @@ public:
   
   // accessors
   ProgramState GetProgramState() { return iProgramState; }
+  PcrStatus GetErrorStatus() { return iErrorStatus; } //why the program state is EError
   ThermalState GetThermalState();
   Step* GetCurrentStep() { return ipCurrentStep; }
-  Cycle* GetDisplayCycle() { return ipDisplayCycle; }
   int GetNumCycles();
   int GetCurrentCycleNum();
   const char* GetProgName() { return iszProgName; }
   Display* GetDisplay() { return ipDisplay; }
-  ProgramComponentPool<Cycle, 4>& GetCyclePool() { return iCyclePool; }
-  ProgramComponentPool<Step, 20>& GetStepPool() { return iStepPool; }
+  Program& GetProgram() { return iProgram; }
   
   boolean Ramping() { return iRamping; }
-  int GetPeltierPwm() { return iPeltierPwm; }
-  double GetLidTemp() { return iLidThermistor.GetTemp(); }
-  double GetPlateTemp() { return iPlateThermistor.GetTemp(); }
+  int GetPeltierPwm();
+  TTemp GetLidTemp();
+  TTemp GetPlateTemp(); //estimated block temperature, ahead of the lagging thermistor
+  TTemp GetSampleTemp();
   unsigned long GetTimeRemainingS() { return iEstimatedTimeRemainingS; }
   unsigned long GetElapsedTimeS() { return (millis() - iProgramStartTimeMs) / 1000; }
   unsigned long GetRampElapsedTimeMs() { return millis() - iRampStartTime; }
   boolean InControlledRamp() { return iRamping && ipCurrentStep->GetRampDurationS() > 0 && ipPreviousStep != NULL; }
   
   // control
-  void SetProgram(Cycle* pProgram, Cycle* pDisplayCycle, const char* szProgName, int lidTemp); //takes ownership of cycles
+  void SetProgram(Program* pProgram, const char* szProgName, int lidTemp,
+                  int sampleVolumeUl, TTemp maxBlockOvershoot, TTemp preheatTemp);
   void Stop();
   PcrStatus Start();
+  void Resume(SRunCheckpoint& checkpoint); //the program just started continues from the checkpoint
+  PcrStatus StartAutotune(); //measures the plate gain schedule and stores it
   void ProcessCommand(SCommand& command);
   
   // internal
   void Loop();
+  void ControlTick(); //runs from the Timer1 overflow interrupt
+  void SuspendControl();
+  void ResumeControl();
   
 private:
   void CheckPower();
@@ -99,11 +112,15 @@ private:
   void ControlPeltier();
   void ControlLid();
   void PreprocessProgram();
+  boolean PreprocessSteps(const SProgramLoop& loop, Step* pPreviousStep, int passes);
   void UpdateEta();
+  void WriteCheckpoint();
  
   //util functions
   void AdvanceToNextStep();
   void SetPlateControlStrategy();
+  TTemp GetHoldTemp();
+  void LoadPlateGains();
   void SetPeltier(ThermalDirection dir, int pwm);
   
 private:
@@ -112,15 +129,15 @@ private:
   SerialControl* ipSerialControl;
   CLidThermistor iLidThermistor;
   CPlateThermistor iPlateThermistor;
-  ProgramComponentPool<Cycle, 4> iCyclePool;
-  ProgramComponentPool<Step, 20> iStepPool;
+  CPlateEstimator iPlateEstimator;
+  Program iProgram;
   
   // state
   ProgramState iProgramState;
-  double iTargetPlateTemp;
-  double iTargetLidTemp;
-  Cycle* ipProgram;
-  Cycle* ipDisplayCycle;
+  PcrStatus iErrorStatus;
+  TTemp iTargetPlateTemp;
+  TTemp iTargetLidTemp;
+  Program* ipProgram;
   char iszProgName[21];
   Step* ipPreviousStep;
   Step* ipCurrentStep;
@@ -128,28 +145,49 @@ private:
   boolean iRamping;
   boolean iDecreasing;
   boolean iRestarted;
+  boolean iSampleHold;      //step holds timed on the estimated sample instead of the block
+  TTemp iMaxBlockOvershoot;
+  TTemp iPreheatTemp;       //plate pre-hold while the lid heats, 0 for none
+  TTemp iPreheatStartTemp;
+  
+  // power loss resume
+  boolean iResuming;        //from the step the program was seeked to, once the lid has warmed
+  unsigned long iResumeElapsedS;
+  uint16_t iHoldCreditS;    //of the next hold, done before the reset
+  unsigned long iCheckpointTimeMs;
+  
+  // boost, the block past the step while the sample catches up
+  TTemp iBlockTarget;
+  TTemp iBoost;             //largest overshoot left for this transition
+  uint16_t iBoostTicks;     //left once the block reaches the step
+  boolean iBoostStarted;
   
   ControlMode iPlateControlMode;
   
   // peltier control
-  PID iPlatePid;
+  CPlateTrajectory iPlateTrajectory;
+  CPIDController iPlatePid;
+  SPlateGainSchedule iPlateGains;
+  CPlateAutotune iPlateAutotune;
+  CIterativeLearning iPlateLearning;
   CPIDController iLidPid;
   ThermalDirection iThermalDirection; //holds actual real-time state
-  double iPeltierPwm;
+  int iPeltierPwm;
+  uint8_t iControlSuspendCount;
   
   // program eta calculation
   unsigned long iProgramStartTimeMs;
   unsigned long iProgramHoldDurationS;
   
   unsigned long iProgramControlledRampDurationS;
-  double iProgramFastRampDegrees;
-  double iElapsedFastRampDegrees;
+  CRampModel iRampModel;
+  unsigned long iProgramFastRampMs;      //predicted by the ramp model
+  unsigned long iElapsedFastRampPredictedMs;
   unsigned long iTotalElapsedFastRampDurationMs;
   
-  double iRampStartTemp;
+  TTemp iRampStartTemp;
   unsigned long iRampStartTime;
   unsigned long iEstimatedTimeRemainingS;
-  boolean iHasCooled;
 };
 
 #endif
@@ -0,0 +1,145 @@
+/*
+ *  trajectory.cpp - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pcr_includes.h"
+#include "pid.h"
+#include "trajectory.h"
+
+//until the ramps measure it, the estimator's model of the block at full drive
+#define TRAJECTORY_TICK_S (CONTROL_TICK_US / 1000000.0)
+#define TRAJECTORY_DEFAULT_STEP ((long)(PLATE_DRIVE_RATE * TRAJECTORY_TICK_S * TEMP_SCALE * (1L << TRAJECTORY_FRACTION_BITS) + 0.5))
+
+//fast ramps plan above the measured rate, which falls with temperature when heating and
+//rises when cooling; the reference waits for a block that falls further behind, so the
+//block runs at full drive and the PID does not wind up
+#define TRAJECTORY_RATE_PERCENT 200
+#define TRAJECTORY_MAX_LAG TEMP_C(0.3)
+//the Peltier reverses within a tick, but the block settles better stopped over about 1 s
+#define TRAJECTORY_BRAKE_TICKS 6
+
+//capability is measured while the reference moves and the drive pushes it with at least
+//half of full scale, each tick moves the estimate 1/2^n of the way
+#define TRAJECTORY_LEARN_BITS 6
+#define TRAJECTORY_LEARN_MIN_PERCENT 50
+#define TRAJECTORY_MIN_STEP (TRAJECTORY_DEFAULT_STEP / 4)
+#define TRAJECTORY_MAX_STEP (TRAJECTORY_DEFAULT_STEP * 4)
+
+//a controlled ramp's rate per second is scaled to the tick as 10230/62500 s; past the
+//fastest rate planned it is no limit, which also keeps the product in an unsigned long
+#define TRAJECTORY_TICK_NUMERATOR (CONTROL_TICK_US / 16)
+#define TRAJECTORY_TICK_DENOMINATOR (1000000L / 16)
+#define TRAJECTORY_MAX_LIMIT_PER_S (TRAJECTORY_MAX_STEP * TRAJECTORY_RATE_PERCENT / 100 * TRAJECTORY_TICK_DENOMINATOR / TRAJECTORY_TICK_NUMERATOR)
+static_assert(CONTROL_TICK_US % 16 == 0, "the tick is scaled exactly");
+static_assert(TRAJECTORY_MAX_LIMIT_PER_S <= 0xFFFFFFFFUL / TRAJECTORY_TICK_NUMERATOR, "the rate limit is scaled in an unsigned long");
+
+////////////////////////////////////////////////////////////////////
+// Class CPlateTrajectory
+CPlateTrajectory::CPlateTrajectory(int maxOutput):
+  iMaxOutput(maxOutput),
+  iHeatingRate(TRAJECTORY_DEFAULT_STEP),
+  iCoolingRate(TRAJECTORY_DEFAULT_STEP),
+  iRateLimit(0),
+  iReference(0),
+  iVelocity(0),
+  iPreviousTemp(0),
+  iObserved(false) {
+}
+//------------------------------------------------------------------------------
+TTemp CPlateTrajectory::GetReference() {
+  return (iReference + (1L << (TRAJECTORY_FRACTION_BITS - 1))) >> TRAJECTORY_FRACTION_BITS;
+}
+//------------------------------------------------------------------------------
+long CPlateTrajectory::GetRate() {
+  return iVelocity >> (TRAJECTORY_FRACTION_BITS - PID_RATE_FRACTION_BITS);
+}
+//------------------------------------------------------------------------------
+int CPlateTrajectory::GetFeedforward() {
+  long feedforward = iVelocity * iMaxOutput / (iVelocity > 0 ? iHeatingRate : iCoolingRate);
+  return constrain(feedforward, -iMaxOutput, iMaxOutput);
+}
+//------------------------------------------------------------------------------
+void CPlateTrajectory::Reset(TTemp temp) {
+  iReference = (long)temp * (1L << TRAJECTORY_FRACTION_BITS);
+  iVelocity = 0;
+}
+//------------------------------------------------------------------------------
+void CPlateTrajectory::SetRateLimit(TTemp change, unsigned long durationS) {
+  //from the change itself, so a ramp slower than a TEMP_SCALE unit a second keeps its rate
+  iRateLimit = 0;
+  if (durationS == 0 || change == 0)
+    return;
+  unsigned long ratePerS = ((unsigned long)abs(change) << TRAJECTORY_FRACTION_BITS) / durationS;
+  if (ratePerS >= TRAJECTORY_MAX_LIMIT_PER_S)
+    return;
+  iRateLimit = (ratePerS * TRAJECTORY_TICK_NUMERATOR + TRAJECTORY_TICK_DENOMINATOR / 2) / TRAJECTORY_TICK_DENOMINATOR;
+  if (iRateLimit == 0)
+    iRateLimit = 1;
+}
+//------------------------------------------------------------------------------
+void CPlateTrajectory::Observe(int peltierPwm, TTemp blockTemp) {
+  //full drive rate from a tick the drive moved the block along the reference
+  if (iObserved && iVelocity != 0 && (peltierPwm > 0) == (iVelocity > 0) &&
+      abs(peltierPwm) * 100L >= (long)iMaxOutput * TRAJECTORY_LEARN_MIN_PERCENT) {
+    //the change is negative while cooling, so it is scaled by multiplying rather than shifting
+    long rate = (long)(blockTemp - iPreviousTemp) * (1L << TRAJECTORY_FRACTION_BITS) * iMaxOutput / abs(peltierPwm);
+    long* pRate = peltierPwm > 0 ? &iHeatingRate : &iCoolingRate;
+    if (peltierPwm < 0)
+      rate = -rate;
+    *pRate += (constrain(rate, TRAJECTORY_MIN_STEP, TRAJECTORY_MAX_STEP) - *pRate) >> TRAJECTORY_LEARN_BITS;
+  }
+  iPreviousTemp = blockTemp;
+  iObserved = true;
+}
+//------------------------------------------------------------------------------
+void CPlateTrajectory::Update(TTemp target, TTemp blockTemp) {
+  long error = (long)target * (1L << TRAJECTORY_FRACTION_BITS) - iReference;
+  if (error == 0 && iVelocity == 0)
+    return;
+  
+  //speed toward the target, negative while the reference still moves away from it
+  boolean heating = error > 0;
+  long distance = heating ? error : -error;
+  long speed = heating ? iVelocity : -iVelocity;
+  long maxRate = GetMaxRate(heating);
+  long brake = maxRate / TRAJECTORY_BRAKE_TICKS > 0 ? maxRate / TRAJECTORY_BRAKE_TICKS : 1;
+  
+  //brake once the distance to stop at this speed reaches the target
+  if (speed > 0 && speed * (speed + brake) / (2 * brake) >= distance)
+    speed -= brake;
+  else if (speed > maxRate)
+    speed = speed - brake > maxRate ? speed - brake : maxRate;
+  else
+    speed = maxRate;
+  
+  if (speed >= distance || (speed <= 0 && distance <= brake)) {
+    //arrived
+    iReference = (long)target * (1L << TRAJECTORY_FRACTION_BITS);
+    iVelocity = 0;
+  } else {
+    long reference = iReference + (heating ? speed : -speed);
+    long lagLimit = (long)(heating ? blockTemp + TRAJECTORY_MAX_LAG : blockTemp - TRAJECTORY_MAX_LAG) * (1L << TRAJECTORY_FRACTION_BITS);
+    if (heating ? reference > lagLimit : reference < lagLimit)
+      reference = (heating ? lagLimit > iReference : lagLimit < iReference) ? lagLimit : iReference;
+    iVelocity = reference - iReference;
+    iReference = reference;
+  }
+}
+//------------------------------------------------------------------------------
+long CPlateTrajectory::GetMaxRate(boolean heating) {
+  long maxRate = (heating ? iHeatingRate : iCoolingRate) * TRAJECTORY_RATE_PERCENT / 100;
+  return iRateLimit > 0 && iRateLimit < maxRate ? iRateLimit : maxRate;
+}
@@ -0,0 +1,61 @@
+/*
+ *  trajectory.h - OpenPCR control software.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TRAJECTORY_H_
+#define _TRAJECTORY_H_
+
+//reference and rate are kept in TEMP_SCALE units with TRAJECTORY_FRACTION_BITS below
+//them, so slow controlled ramps still move every tick
+#define TRAJECTORY_FRACTION_BITS 8
+
+////////////////////////////////////////////////////////////////////
+// Class CPlateTrajectory
+//Setpoint generator for the plate. Plans a rate limited reference from the current
+//one to the step temperature that brakes into it, paced by what the Peltier was
+//measured to deliver in each direction, and the drive that holds the block on it.
+class CPlateTrajectory {
+public:
+  CPlateTrajectory(int maxOutput);
+  
+  //accessors
+  TTemp GetReference();
+  long GetRate(); //planned change per control tick, PID_RATE_FRACTION_BITS below TEMP_SCALE
+  int GetFeedforward(); //drive for the planned rate
+  
+  //configuration
+  void Reset(TTemp temp); //reference at temp, at rest
+  void SetRateLimit(TTemp change, unsigned long durationS); //the change over durationS, 0 s for as fast as the Peltier allows
+  
+  //computation, once per control tick
+  void Observe(int peltierPwm, TTemp blockTemp); //measures the Peltier with the drive applied since the last tick
+  void Update(TTemp target, TTemp blockTemp);
+  
+private:
+  long GetMaxRate(boolean heating);
+  
+private:
+  int iMaxOutput;
+  long iHeatingRate; //block change per tick at full drive, measured
+  long iCoolingRate;
+  long iRateLimit;   //per tick, 0 for none
+  long iReference;
+  long iVelocity;    //reference change per tick
+  TTemp iPreviousTemp;
+  boolean iObserved;
+};
+
+#endif
@@ -20,25 +20,24 @@
 #include "thermocycler.h"
 #include "display.h"
 
-const char FLOAT_PAD_FORM_STR[] PROGMEM = "%3d.%d";
-const char FLOAT_FORM_STR[] PROGMEM = "%d.%d";
-
-void sprintFloat(char* str, float val, int decimalDigits, boolean pad) {
-  long factor = pow(10, decimalDigits);
-  long intVal;
-
-  if (val > 0)
-    intVal = val * factor + 0.5;
+const char TEMP_PAD_FORM_STR[] PROGMEM = "%3d.%d";
+const char TEMP_FORM_STR[] PROGMEM = "%d.%d";
+
+//prints temp with one decimal digit
+void sprintTemp(char* str, TTemp temp, boolean pad) {
+  int tenths;
+  if (temp > 0)
+    tenths = (temp + TEMP_SCALE / 20) / (TEMP_SCALE / 10);
   else
-    intVal = val * factor - 0.5;
+    tenths = (temp - TEMP_SCALE / 20) / (TEMP_SCALE / 10);
     
-  int decimal = intVal % factor;
-  int number = intVal / factor;
+  int decimal = tenths % 10;
+  int number = tenths / 10;
 
   if (pad)
-    sprintf_P(str, FLOAT_PAD_FORM_STR, number, abs(decimal));
+    sprintf_P(str, TEMP_PAD_FORM_STR, number, abs(decimal));
   else
-    sprintf_P(str, FLOAT_FORM_STR, number, abs(decimal));
+    sprintf_P(str, TEMP_FORM_STR, number, abs(decimal));
 }
 
 void* operator new(size_t size) {
@@ -89,14 +88,7 @@ void operator delete(void * ptr) {
 void __cxa_pure_virtual(void) {};
 
 unsigned short htons(unsigned short val) {
-  return val << 8 + (byte)val;
-}
-
-double absf(double val) {
-  if (val < 0)
-    return val * -1;
-  else
-    return val;
+  return (val << 8) | (val >> 8);
 }
 
 char* rps(const char* progString) {
@@ -0,0 +1,99 @@
+/*
+ *  bench_thermistors.cpp - per-conversion cost of the thermistor lookups.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define READ_CYCLES() __rdtsc()
+#else
+#include <chrono>
+#define READ_CYCLES() ((unsigned long long)std::chrono::steady_clock::now().time_since_epoch().count())
+#endif
+
+#include "mockhal.h"
+
+#include "pcr_includes.h"
+#include "thermistors.h"
+
+#define LID_ADC_CODES 1024
+#define PLATE_ADC_CODES 0x200000
+#define PLATE_SWEEP_STEP 128
+#define CONVERSION_WAIT_MS 200
+#define REPEATS 16
+
+struct SLookupCost {
+  unsigned long worstReads;
+  double totalReads;
+  unsigned long long worstCycles;
+  double totalCycles;
+  unsigned long numConversions;
+};
+
+void AddConversion(SLookupCost& cost, unsigned long reads, unsigned long long cycles) {
+  if (reads > cost.worstReads)
+    cost.worstReads = reads;
+  if (cycles > cost.worstCycles)
+    cost.worstCycles = cycles;
+  cost.totalReads += reads;
+  cost.totalCycles += cycles;
+  cost.numConversions++;
+}
+
+void PrintCost(const char* szTable, const SLookupCost& cost) {
+  printf("  %-6s flash reads/conversion: worst %3lu, mean %6.1f | host cycles/conversion: worst %6llu, mean %7.1f\n",
+    szTable, cost.worstReads, cost.totalReads / cost.numConversions, cost.worstCycles, cost.totalCycles / cost.numConversions);
+}
+
+//best of several repeats, to keep scheduler noise out of the worst case
+template <class TThermistor>
+void MeasureConversion(TThermistor& thermistor, SLookupCost& cost) {
+  unsigned long reads = 0;
+  unsigned long long bestCycles = ~0ULL;
+  for (int i = 0; i < REPEATS; i++) {
+    MockAdvanceMillis(CONVERSION_WAIT_MS); //plate conversion ready, outside the timed region
+    unsigned long startReads = gMockProgmemReads;
+    unsigned long long start = READ_CYCLES();
+    thermistor.ReadTemp();
+    unsigned long long cycles = READ_CYCLES() - start;
+    reads = gMockProgmemReads - startReads;
+    if (cycles < bestCycles)
+      bestCycles = cycles;
+  }
+  AddConversion(cost, reads, bestCycles);
+}
+
+int main(int argc, char** argv) {
+  MockReset(true);
+  SLookupCost lidCost = { 0 }, plateCost = { 0 };
+
+  CLidThermistor lid;
+  for (int code = 0; code < LID_ADC_CODES; code++) {
+    MockSetAnalogInput(A1, code);
+    MeasureConversion(lid, lidCost);
+  }
+
+  CPlateThermistor plate;
+  for (unsigned long code = 0; code < PLATE_ADC_CODES; code += PLATE_SWEEP_STEP) {
+    MockSetPlateAdcCode(code);
+    MeasureConversion(plate, plateCost);
+  }
+
+  printf("%s\n", argc > 1 ? argv[1] : "thermistors");
+  PrintCost("lid", lidCost);
+  PrintCost("plate", plateCost);
+  return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ *  check_fixedpoint.cpp - fixed point control path against the float reference.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define READ_CYCLES() __rdtsc()
+#else
+#include <chrono>
+#define READ_CYCLES() ((unsigned long long)std::chrono::steady_clock::now().time_since_epoch().count())
+#endif
+
+#include "mockhal.h"
+
+#include "pcr_includes.h"
+#include "pid.h"
+
+#define CONTROL_STEPS 20000
+#define REPEATS 16
+
+#define MAX_PWM_ERROR 1
+
+////////////////////////////////////////////////////////////////////
+// Float reference, the control math without fixed point
+#define REF_MAX_ERROR 20.0
+#define REF_MAX_RATE 2.0
+#define REF_RATE_FILTER 0.25
+#define REF_ANTIWINDUP (1 / 64.0)
+
+const SPIDTuning LID_GAIN_SCHEDULE[] = {
+  { TEMP_C(70), 4000, 92, 982 },
+  { TEMP_C(80), 8000, 672, 164 }
+};
+
+const SPIDTuning PLATE_HEATING_SCHEDULE[] = {
+  { TEMP_C(30), 60000, 12220, 3274 },
+  { TEMP_C(55), 300000, 45825, 24552 },
+  { TEMP_C(85), 300000, 45825, 24552 }
+};
+
+const SPIDTuning PLATE_COOLING_SCHEDULE[] = {
+  { TEMP_C(30), 200000, 6110, 1637 },
+  { TEMP_C(55), 300000, 45825, 24552 },
+  { TEMP_C(85), 80000, 42770, 2455 }
+};
+
+class RefPIDController {
+public:
+  RefPIDController(const SPIDTuning* pHeatingSchedule, const SPIDTuning* pCoolingSchedule, int numPoints,
+                   double minOutput, double maxOutput, double sampleS):
+    ipHeatingSchedule(pHeatingSchedule), ipCoolingSchedule(pCoolingSchedule), iNumPoints(numPoints),
+    iMinOutput(minOutput), iMaxOutput(maxOutput), iSampleS(sampleS), iCooling(false),
+    iKp(0), iKi(0), iKd(0), iGainsValid(false), iIntegrator(0), iPreviousValue(0), iRate(0), iStarted(false) {}
+
+  void SetCooling(bool cooling) { iCooling = cooling; }
+
+  double Compute(double target, double currentValue) {
+    if (!iStarted) {
+      iPreviousValue = currentValue;
+      iStarted = true;
+    }
+    double error = Clamp(target - currentValue, -REF_MAX_ERROR, REF_MAX_ERROR);
+    double rate = Clamp(currentValue - iPreviousValue, -REF_MAX_RATE, REF_MAX_RATE);
+    iRate += (rate - iRate) * REF_RATE_FILTER;
+    iPreviousValue = currentValue;
+
+    //bumpless gain change
+    double kP, kI, kD;
+    Interpolate(target, kP, kI, kD);
+    if (iGainsValid)
+      iIntegrator = Clamp(iIntegrator + (iKp - kP) * error - (iKd - kD) * iRate, iMinOutput, iMaxOutput);
+    iKp = kP;
+    iKi = kI;
+    iKd = kD;
+    iGainsValid = true;
+
+    iIntegrator += iKi * error;
+    double output = iKp * error + iIntegrator - iKd * iRate;
+    double latchedOutput = Clamp(output, iMinOutput, iMaxOutput);
+    iIntegrator = Clamp(iIntegrator + (latchedOutput - output) * REF_ANTIWINDUP, iMinOutput, iMaxOutput);
+    return latchedOutput;
+  }
+
+private:
+  //gains per sample, linear in target between schedule points
+  void Interpolate(double target, double& kP, double& kI, double& kD) {
+    const SPIDTuning* pPoints = iCooling ? ipCoolingSchedule : ipHeatingSchedule;
+    int low = 0;
+    while (low < iNumPoints - 1 && target >= pPoints[low + 1].temp / (double)TEMP_SCALE)
+      low++;
+    int high = low < iNumPoints - 1 ? low + 1 : low;
+    double lowTemp = pPoints[low].temp / (double)TEMP_SCALE, highTemp = pPoints[high].temp / (double)TEMP_SCALE;
+    double fraction = high != low && target > lowTemp ? (target - lowTemp) / (highTemp - lowTemp) : 0;
+    kP = (pPoints[low].kP + (pPoints[high].kP - pPoints[low].kP) * fraction) / PID_GAIN_SCALE;
+    kI = (pPoints[low].kI + (pPoints[high].kI - pPoints[low].kI) * fraction) / PID_GAIN_SCALE * iSampleS;
+    kD = (pPoints[low].kD + (pPoints[high].kD - pPoints[low].kD) * fraction) / PID_GAIN_SCALE / iSampleS;
+  }
+  double Clamp(double value, double minValue, double maxValue) { return value < minValue ? minValue : value > maxValue ? maxValue : value; }
+
+  const SPIDTuning* ipHeatingSchedule;
+  const SPIDTuning* ipCoolingSchedule;
+  int iNumPoints;
+  double iMinOutput, iMaxOutput, iSampleS;
+  bool iCooling;
+  double iKp, iKi, iKd;
+  bool iGainsValid;
+  double iIntegrator, iPreviousValue, iRate;
+  bool iStarted;
+};
+
+////////////////////////////////////////////////////////////////////
+// Comparison
+struct SComparison {
+  double maxError;
+  unsigned long numSamples;
+  unsigned long numDifferent;
+};
+
+void AddSample(SComparison& comparison, double error) {
+  error = fabs(error);
+  if (error > comparison.maxError)
+    comparison.maxError = error;
+  if (error != 0)
+    comparison.numDifferent++;
+  comparison.numSamples++;
+}
+
+struct SCycles {
+  unsigned long long reference;
+  unsigned long long fixed;
+};
+
+template <class TFunc>
+unsigned long long BestCycles(TFunc func) {
+  unsigned long long best = ~0ULL;
+  for (int i = 0; i < REPEATS; i++) {
+    unsigned long long start = READ_CYCLES();
+    func();
+    unsigned long long cycles = READ_CYCLES() - start;
+    if (cycles < best)
+      best = cycles;
+  }
+  return best;
+}
+
+//deterministic pseudo random walk, so every run compares the same sequence
+unsigned long sRandom = 12345;
+int RandomInRange(int range) {
+  sRandom = sRandom * 1103515245 + 12345;
+  return (int)((sRandom >> 16) % (2 * range + 1)) - range;
+}
+
+bool Report(const char* szName, const SComparison& comparison, double limit, const char* szUnit, const SCycles& cycles) {
+  bool pass = comparison.maxError <= limit;
+  printf("  %-6s max error %.4f %-3s over %6lu samples (%5lu differ) | host cycles float %4llu, fixed %4llu  %s\n",
+    szName, comparison.maxError, szUnit, comparison.numSamples, comparison.numDifferent,
+    cycles.reference, cycles.fixed, pass ? "ok" : "FAIL");
+  return pass;
+}
+
+int main(int argc, char** argv) {
+  MockReset(true);
+  bool pass = true;
+  volatile double sink = 0;
+  printf("%s\n", argc > 1 ? argv[1] : "fixed point");
+
+  //lid controller, heating from ambient to target with sensor noise
+  SComparison lidPid = { 0 };
+  SCycles lidPidCycles = { ~0ULL, ~0ULL };
+  CPIDController fixedLidPid(LID_GAIN_SCHEDULE, LID_GAIN_SCHEDULE, 2, 0, 255, CONTROL_TICK_US);
+  RefPIDController refLidPid(LID_GAIN_SCHEDULE, LID_GAIN_SCHEDULE, 2, 0, 255, CONTROL_TICK_US / 1000000.0);
+  TTemp lidTemp = TEMP_C(25);
+  TTemp lidTarget = TEMP_C(110);
+  for (int i = 0; i < CONTROL_STEPS; i++) {
+    if (i == CONTROL_STEPS / 2)
+      lidTarget = TEMP_C(60);
+    int fixedDrive = fixedLidPid.Compute(lidTarget, lidTemp);
+    int refDrive = refLidPid.Compute(lidTarget / (double)TEMP_SCALE, lidTemp / (double)TEMP_SCALE);
+    AddSample(lidPid, fixedDrive - refDrive);
+    lidTemp += (lidTarget - lidTemp) / 50 + RandomInRange(15);
+  }
+  lidPidCycles.reference = BestCycles([&]() { sink = refLidPid.Compute(lidTarget / (double)TEMP_SCALE, lidTemp / (double)TEMP_SCALE); });
+  lidPidCycles.fixed = BestCycles([&]() { sink = fixedLidPid.Compute(lidTarget, lidTemp); });
+  pass &= Report("lidpid", lidPid, MAX_PWM_ERROR, "pwm", lidPidCycles);
+
+  //plate controller, PCR setpoints between and on the schedule points with sensor noise
+  SComparison platePid = { 0 };
+  SCycles platePidCycles = { ~0ULL, ~0ULL };
+  const TTemp PLATE_TARGETS[] = { TEMP_C(95), TEMP_C(55), TEMP_C(72), TEMP_C(42.5), TEMP_C(4) };
+  const int NUM_PLATE_TARGETS = sizeof(PLATE_TARGETS) / sizeof(PLATE_TARGETS[0]);
+  TTemp plateTemp = TEMP_C(25);
+  TTemp plateTarget = PLATE_TARGETS[0];
+  CPIDController fixedPlatePid(PLATE_HEATING_SCHEDULE, PLATE_COOLING_SCHEDULE, 3, -1023, 1023, CONTROL_TICK_US);
+  RefPIDController refPlatePid(PLATE_HEATING_SCHEDULE, PLATE_COOLING_SCHEDULE, 3, -1023, 1023, CONTROL_TICK_US / 1000000.0);
+  for (int i = 0; i < CONTROL_STEPS; i++) {
+    TTemp target = PLATE_TARGETS[i / 300 % NUM_PLATE_TARGETS];
+    if (target != plateTarget) {
+      fixedPlatePid.SetCooling(target < plateTarget);
+      refPlatePid.SetCooling(target < plateTarget);
+      plateTarget = target;
+    }
+    int fixedPwm = fixedPlatePid.Compute(plateTarget, plateTemp);
+    int refPwm = refPlatePid.Compute(plateTarget / (double)TEMP_SCALE, plateTemp / (double)TEMP_SCALE);
+    AddSample(platePid, fixedPwm - refPwm);
+    plateTemp += (plateTarget - plateTemp) / 20 + RandomInRange(5);
+  }
+  platePidCycles.reference = BestCycles([&]() { sink = refPlatePid.Compute(plateTarget / (double)TEMP_SCALE, plateTemp / (double)TEMP_SCALE); });
+  platePidCycles.fixed = BestCycles([&]() { sink = fixedPlatePid.Compute(plateTarget, plateTemp); });
+  pass &= Report("pltpid", platePid, MAX_PWM_ERROR, "pwm", platePidCycles);
+
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+/*
+ *  check_thermistors.cpp - generated thermistor tables against the sensor model.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "mockhal.h"
+
+//the sensor models are local to thermistors.cpp, so it is built into this file
+#include "thermistors.cpp"
+
+#define PLATE_SWEEP_STEP 37
+#define MAX_LN_ERROR 1e-9
+#define MAX_TEMP_ERROR 0.05
+
+//sensor ranges the tables are held to
+#define LID_CHECK_MIN_TEMP 0
+#define LID_CHECK_MAX_TEMP 125
+#define PLATE_CHECK_MIN_TEMP 0
+#define PLATE_CHECK_MAX_TEMP 105
+
+//double precision reference for one ADC code
+template <class TModel>
+double ModelDegrees(unsigned long code) {
+  double ohms = TModel::PULL_UP_OHMS * code / (TModel::ADC_FULL_SCALE - code);
+  double lnOhms = log(ohms);
+  return 1 / (TModel::A + TModel::B * lnOhms + TModel::C * lnOhms * lnOhms * lnOhms) - KELVIN_OFFSET;
+}
+
+template <class TModel>
+bool CheckSensor(const char* szSensor, double minTemp, double maxTemp, unsigned long step) {
+  double maxError = 0;
+  double worstTemp = 0;
+  unsigned long numCodes = 0;
+  for (unsigned long code = 1; code < TModel::ADC_FULL_SCALE; code += step) {
+    double expected = ModelDegrees<TModel>(code);
+    if (expected < minTemp || expected > maxTemp)
+      continue;
+    double error = fabs(LookupTemp<TModel>(code) / (double)TEMP_SCALE - expected);
+    if (error > maxError) {
+      maxError = error;
+      worstTemp = expected;
+    }
+    numCodes++;
+  }
+  
+  bool pass = maxError <= MAX_TEMP_ERROR;
+  printf("  %-6s %3d entries, %lu codes in %.0f..%.0f C: max error %.4f C at %.2f C  %s\n",
+    szSensor, (1 << TModel::TABLE_BITS) + 1, numCodes, minTemp, maxTemp, maxError, worstTemp, pass ? "ok" : "FAIL");
+  return pass;
+}
+
+bool CheckConstLn() {
+  double maxError = 0;
+  for (double x = 1e-3; x < 1e10; x *= 1.01)
+    maxError = fmax(maxError, fabs(ConstLn(x) - log(x)));
+  
+  bool pass = maxError <= MAX_LN_ERROR;
+  printf("  ConstLn max error %.2g  %s\n", maxError, pass ? "ok" : "FAIL");
+  return pass;
+}
+
+int main(int argc, char** argv) {
+  MockReset(true);
+  printf("%s\n", argc > 1 ? argv[1] : "thermistors");
+  
+  bool pass = CheckConstLn();
+  pass &= CheckSensor<SLidSensor>("lid", LID_CHECK_MIN_TEMP, LID_CHECK_MAX_TEMP, 1);
+  pass &= CheckSensor<SPlateSensor>("plate", PLATE_CHECK_MIN_TEMP, PLATE_CHECK_MAX_TEMP, PLATE_SWEEP_STEP);
+  return pass ? 0 : 1;
+}
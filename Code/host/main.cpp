@@ -0,0 +1,727 @@
+/*
+ *  main.cpp - host runner for the OpenPCR firmware.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LiquidCrystal.h"
+#include "mockhal.h"
+#include "plant.h"
+#include "sensors.h"
+
+#include "pcr_includes.h"
+#include "thermocycler.h"
+#include "serialcontrol.h"
+#include "program.h"
+
+#define STARTUP_WAIT_MS 5000
+#define STATUS_BUFFER_SIZE 256
+#define HOST_PACKET_SIZE 2048 //within the mock serial receive buffer
+#define PLANT_STEP_S 0.001
+
+// pins driven by Thermocycler::SetPeltier and ControlLid
+#define PELTIER_COOL_PIN 2
+#define PELTIER_HEAT_PIN 4
+#define PELTIER_PWM_PIN 9
+#define PELTIER_PWM_MAX 1023.0
+#define LID_PWM_PIN 3
+#define LID_PWM_MAX 255.0
+
+//smaller step changes do not count as a transition
+#define CYCLE_TRACK_DEADBAND 0.5
+//settling runs from entering SETTLE_BAND of the step temperature to the last time the
+//block leaves SETTLE_TOLERANCE during the step
+#define SETTLE_BAND 1.0
+#define SETTLE_TOLERANCE 0.2
+#define MAX_TRACKED_TRANSITIONS 256
+#define SETTLE_REPORT_TRANSITIONS 12
+
+//the time remaining is sampled every second of the program
+#define MAX_ETA_SAMPLES (4 * 3600)
+#define ETA_REPORT_S 60
+
+//lid thermistor noise at the AVR ADC input, heater PWM pickup included
+#define LID_ADC_NOISE_LSB 0.5
+
+//sketch entry points
+void setup();
+void loop();
+
+const char DEFAULT_PROGRAM[] = "n=Host&c=start&l=100&p=(1[10|95|Denature])(1[0|95|Final])";
+const char AUTOTUNE_COMMAND[] = "c=autotune";
+
+struct SRunnerOptions {
+  const char* szProgram;
+  unsigned long loopPeriodMs;
+  unsigned long maxDurationS;
+  double lidTemp;
+  double plateTemp;
+  int numRuns;
+  bool verbose;
+  bool simulate;
+  double sampleVolumeUl;
+  double ambientTemp;
+  double blockCapacity;
+  bool autotune;
+  bool binary;
+};
+
+struct SRunStats {
+  unsigned long numLoops;
+  unsigned long simulatedMs;
+  double totalLoopNs;
+  double maxLoopNs;
+  Thermocycler::ProgramState finalState;
+  unsigned long eepromWrites;
+  unsigned long eepromStallUs; //Loop() waiting on EEPROM writes in progress
+
+  // closed loop metrics, only filled in when simulating the plant
+  unsigned long lidWaitStartMs;
+  unsigned long programStartMs;
+  unsigned long programEndMs;
+  unsigned long numTransitions;
+  unsigned long totalRampMs;
+  double maxBlockOvershoot;
+  double maxSampleOvershoot;
+  unsigned long lidPwmTravel; //sum of lid PWM changes while the program runs
+  double maxLidWaitPlateExcess; //block against lid while the lid heats, condensation above 0
+  unsigned long runningMs;
+  double totalPlateError;     //firmware plate temperature against the block, while running
+  double maxPlateError;
+  double totalSampleError;    //firmware sample temperature against the tube, while running
+  double maxSampleError;
+  unsigned long numHolds;
+  double totalHoldShortfall;  //how far the tube still was from the step when its hold began
+  double maxHoldShortfall;
+  unsigned long numSampleArrivals;
+  unsigned long totalSampleArrivalMs; //from the start of a transition until the tube reaches the step
+  unsigned long numEtaSamples;
+  unsigned long settleMs[MAX_TRACKED_TRANSITIONS]; //per transition
+  unsigned long numSettled;
+};
+
+struct STransitionTracker {
+  Step* pStep;
+  int direction; //1 heating, -1 cooling, 0 no temperature change
+  unsigned long startMs;
+  unsigned long bandMs;
+  unsigned long lastOutsideMs;
+  boolean rampDone;
+  boolean sampleArrived;
+};
+
+static ThermalPlant* spPlant = NULL;
+static SRunStats* spStats = NULL;
+static STransitionTracker sTracker;
+static int sLastLidPwm = 0;
+static unsigned long sEtaS[MAX_ETA_SAMPLES]; //time remaining the firmware reported, per second of the program
+
+//temperatures are TTemp in the fixed point firmware and float or double in the others
+double Degrees(TTemp temp) { return temp / (double)TEMP_SCALE; }
+double Degrees(double temp) { return temp; }
+double StepDegrees(Step* pStep) { return Degrees(pStep->GetTemp()); }
+
+void TrackTransitions(unsigned long nowMs) {
+  Thermocycler::ProgramState state = GetThermocycler().GetProgramState();
+  if (state == Thermocycler::ELidWait && spStats->lidWaitStartMs == 0)
+    spStats->lidWaitStartMs = nowMs;
+  if (state == Thermocycler::EComplete && spStats->programEndMs == 0)
+    spStats->programEndMs = nowMs;
+
+  Step* pStep = NULL;
+  if (state == Thermocycler::ERunning || state == Thermocycler::EComplete)
+    pStep = GetThermocycler().GetCurrentStep();
+
+  if (pStep != sTracker.pStep) {
+    if (sTracker.bandMs != 0 && spStats->numSettled < MAX_TRACKED_TRANSITIONS)
+      spStats->settleMs[spStats->numSettled++] = sTracker.lastOutsideMs - sTracker.bandMs;
+    if (spStats->programStartMs == 0)
+      spStats->programStartMs = nowMs;
+
+    double delta = pStep ? StepDegrees(pStep) - spPlant->GetBlockTemp() : 0;
+    sTracker.direction = delta > CYCLE_TRACK_DEADBAND ? 1 : delta < -CYCLE_TRACK_DEADBAND ? -1 : 0;
+    sTracker.pStep = pStep;
+    sTracker.startMs = nowMs;
+    sTracker.bandMs = 0;
+    sTracker.lastOutsideMs = 0;
+    sTracker.rampDone = false;
+    sTracker.sampleArrived = false;
+    if (pStep != NULL && sTracker.direction != 0)
+      spStats->numTransitions++;
+  }
+  if (pStep == NULL || sTracker.direction == 0)
+    return;
+
+  double blockError = fabs(spPlant->GetBlockTemp() - StepDegrees(pStep));
+  if (sTracker.bandMs == 0 && blockError < SETTLE_BAND)
+    sTracker.bandMs = nowMs;
+  if (sTracker.bandMs != 0 && blockError > SETTLE_TOLERANCE)
+    sTracker.lastOutsideMs = nowMs;
+  if (!sTracker.rampDone && !GetThermocycler().Ramping()) {
+    sTracker.rampDone = true;
+    spStats->totalRampMs += nowMs - sTracker.startMs;
+
+    double holdShortfall = (StepDegrees(pStep) - spPlant->GetSampleTemp()) * sTracker.direction;
+    spStats->numHolds++;
+    spStats->totalHoldShortfall += holdShortfall;
+    if (holdShortfall > spStats->maxHoldShortfall)
+      spStats->maxHoldShortfall = holdShortfall;
+  }
+
+  if (!sTracker.sampleArrived && fabs(spPlant->GetSampleTemp() - StepDegrees(pStep)) <= SETTLE_TOLERANCE) {
+    sTracker.sampleArrived = true;
+    spStats->numSampleArrivals++;
+    spStats->totalSampleArrivalMs += nowMs - sTracker.startMs;
+  }
+
+  double blockOvershoot = (spPlant->GetBlockTemp() - StepDegrees(pStep)) * sTracker.direction;
+  double sampleOvershoot = (spPlant->GetSampleTemp() - StepDegrees(pStep)) * sTracker.direction;
+  if (blockOvershoot > spStats->maxBlockOvershoot)
+    spStats->maxBlockOvershoot = blockOvershoot;
+  if (sampleOvershoot > spStats->maxSampleOvershoot)
+    spStats->maxSampleOvershoot = sampleOvershoot;
+}
+
+void TrackLid() {
+  if (GetThermocycler().GetProgramState() == Thermocycler::ELidWait) {
+    double excess = spPlant->GetBlockTemp() - spPlant->GetLidTemp();
+    if (excess > spStats->maxLidWaitPlateExcess)
+      spStats->maxLidWaitPlateExcess = excess;
+  }
+
+  int lidPwm = MockGetAnalogOutput(LID_PWM_PIN);
+  if (GetThermocycler().GetProgramState() == Thermocycler::ERunning) {
+    spStats->lidPwmTravel += abs(lidPwm - sLastLidPwm);
+    spStats->runningMs++;
+  }
+  sLastLidPwm = lidPwm;
+}
+
+void TrackPlateReading() {
+  if (GetThermocycler().GetProgramState() != Thermocycler::ERunning)
+    return;
+
+  double error = fabs(Degrees(GetThermocycler().GetPlateTemp()) - spPlant->GetBlockTemp());
+  spStats->totalPlateError += error;
+  if (error > spStats->maxPlateError)
+    spStats->maxPlateError = error;
+
+#ifdef PLATE_GAIN_BANDS
+  error = fabs(Degrees(GetThermocycler().GetSampleTemp()) - spPlant->GetSampleTemp());
+  spStats->totalSampleError += error;
+  if (error > spStats->maxSampleError)
+    spStats->maxSampleError = error;
+#endif
+}
+
+void TrackEta(unsigned long nowMs) {
+  if (GetThermocycler().GetProgramState() != Thermocycler::ERunning || spStats->programStartMs == 0)
+    return;
+
+  unsigned long programMs = nowMs - spStats->programStartMs;
+  if (programMs % 1000 == 0 && programMs / 1000 == spStats->numEtaSamples && spStats->numEtaSamples < MAX_ETA_SAMPLES)
+    sEtaS[spStats->numEtaSamples++] = GetThermocycler().GetTimeRemainingS();
+}
+
+//runs every simulated millisecond: actuators in, sensors out
+void PlantTick(unsigned long nowMs) {
+  double peltierDrive = MockGetAnalogOutput(PELTIER_PWM_PIN) / PELTIER_PWM_MAX;
+  if (MockGetDigitalOutput(PELTIER_COOL_PIN) == HIGH)
+    peltierDrive = -peltierDrive;
+  else if (MockGetDigitalOutput(PELTIER_HEAT_PIN) != HIGH)
+    peltierDrive = 0;
+
+  spPlant->Step(PLANT_STEP_S, peltierDrive, MockGetAnalogOutput(LID_PWM_PIN) / LID_PWM_MAX);
+  MockSetAnalogInput(A1, LidAdcFromTemp(spPlant->GetLidSensorTemp()));
+  MockSetPlateAdcCode(PlateAdcCodeFromTemp(spPlant->GetPlateSensorTemp()));
+
+  if (gpThermocycler != NULL) {
+    TrackTransitions(nowMs);
+    TrackLid();
+    TrackPlateReading();
+    TrackEta(nowMs);
+  }
+}
+
+//text commands may be longer than the firmware's receive buffer
+void SendPacket(uint8_t type, const char* szPayload) {
+  uint8_t packet[HOST_PACKET_SIZE];
+  size_t payloadLength = strlen(szPayload);
+  uint16_t length = sizeof(PCPPacket) + payloadLength;
+  if (length > sizeof(packet)) {
+    fprintf(stderr, "command of %zu bytes is too long\n", payloadLength);
+    exit(1);
+  }
+
+  packet[0] = START_CODE;
+  packet[1] = length & 0xFF;
+  packet[2] = length >> 8;
+  packet[3] = type;
+  memcpy(packet + sizeof(PCPPacket), szPayload, payloadLength);
+  MockSerialReceive(packet, length);
+}
+
+//only the fixed point firmware takes binary commands
+#ifdef BINARY_COMMAND_VERSION
+#define HAS_BINARY_COMMANDS true
+#define MAX_BINARY_NAMES 64
+
+struct SBinaryWriter {
+  uint8_t* pData;
+  uint8_t* pEnd;
+  bool overflow;
+};
+
+void PutByte(SBinaryWriter& writer, unsigned long value) {
+  if (writer.pData < writer.pEnd)
+    *writer.pData++ = value;
+  else
+    writer.overflow = true;
+}
+
+void PutInt16(SBinaryWriter& writer, double degrees) {
+  int16_t value = (int16_t)lround(degrees * 100);
+  PutByte(writer, value & 0xFF);
+  PutByte(writer, (uint16_t)value >> 8);
+}
+
+void PutVarint(SBinaryWriter& writer, unsigned long value) {
+  while (value >= 0x80) {
+    PutByte(writer, (value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  PutByte(writer, value);
+}
+
+void PutString(SBinaryWriter& writer, const char* szValue, size_t length) {
+  PutByte(writer, length);
+  for (size_t i = 0; i < length; i++)
+    PutByte(writer, szValue[i]);
+}
+
+//the text command in the binary format, 0 if it has no binary form
+size_t EncodeBinaryCommand(const char* szCommand, uint8_t* pBuffer, size_t bufferSize) {
+  char command[STATUS_BUFFER_SIZE];
+  if (strlen(szCommand) >= sizeof(command))
+    return 0;
+  strcpy(command, szCommand);
+
+  int type = -1;
+  unsigned long slot = 0, commandId = 0, lidTemp = 0, sampleVolume = 0;
+  double maxBlockOvershoot = 0, preheatTemp = 0;
+  const char* szName = "";
+  char* pProgram = NULL;
+  char* pSave;
+  for (char* pParam = strtok_r(command, "&", &pSave); pParam != NULL; pParam = strtok_r(NULL, "&", &pSave)) {
+    if (pParam[0] == '\0' || pParam[1] != '=')
+      continue;
+    const char* szValue = pParam + 2;
+    switch (pParam[0]) {
+    case 'n': szName = szValue; break;
+    case 'c':
+      type = strcmp(szValue, "start") == 0 ? SCommand::EStart : strcmp(szValue, "stop") == 0 ? SCommand::EStop :
+             strcmp(szValue, "save") == 0 ? SCommand::ESave : strcmp(szValue, "run") == 0 ? SCommand::ERun : -1;
+      break;
+    case 'l': lidTemp = strtoul(szValue, NULL, 10); break;
+    case 'v': sampleVolume = strtoul(szValue, NULL, 10); break;
+    case 'b': maxBlockOvershoot = atof(szValue); break;
+    case 'h': preheatTemp = atof(szValue); break;
+    case 's': slot = strtoul(szValue, NULL, 10); break;
+    case 'd': commandId = strtoul(szValue, NULL, 10); break;
+    case 'p': pProgram = pParam + 2; break;
+    }
+  }
+  if (type < 0)
+    return 0;
+
+  //the steps, with each name stored once
+  const char* names[MAX_BINARY_NAMES];
+  int numNames = 0;
+  uint8_t loops[STATUS_BUFFER_SIZE];
+  SBinaryWriter loopWriter = { loops, loops + sizeof(loops), false };
+  int numLoops = 0;
+  char* pLoopSave;
+  for (char* pLoop = pProgram ? strtok_r(pProgram, "()", &pLoopSave) : NULL; pLoop != NULL; pLoop = strtok_r(NULL, "()", &pLoopSave)) {
+    char* pStep = strchr(pLoop, '[');
+    if (pStep == NULL)
+      return 0;
+    PutVarint(loopWriter, strtoul(pLoop, NULL, 10));
+    uint8_t* pNumSteps = loopWriter.pData;
+    PutByte(loopWriter, 0);
+    for (; pStep != NULL; pStep = strchr(pStep, '[')) {
+      char* pStepEnd = strchr(pStep, ']');
+      if (pStepEnd == NULL)
+        return 0;
+      *pStepEnd = '\0';
+      char* fields[4] = { pStep + 1, NULL, NULL, NULL };
+      for (int i = 1; i < 4 && fields[i - 1] != NULL; i++) {
+        fields[i] = strchr(fields[i - 1], '|');
+        if (fields[i] != NULL)
+          *fields[i]++ = '\0';
+      }
+      if (fields[2] == NULL)
+        return 0;
+
+      int nameIndex = 0;
+      while (nameIndex < numNames && strcmp(names[nameIndex], fields[2]) != 0)
+        nameIndex++;
+      if (nameIndex == numNames) {
+        if (numNames == MAX_BINARY_NAMES)
+          return 0;
+        names[numNames++] = fields[2];
+      }
+
+      PutInt16(loopWriter, atof(fields[1]));
+      PutVarint(loopWriter, strtoul(fields[0], NULL, 10));
+      PutVarint(loopWriter, fields[3] ? strtoul(fields[3], NULL, 10) : 0);
+      PutByte(loopWriter, nameIndex);
+      if (!loopWriter.overflow)
+        (*pNumSteps)++;
+      pStep = pStepEnd + 1;
+    }
+    numLoops++;
+  }
+
+  SBinaryWriter writer = { pBuffer, pBuffer + bufferSize, false };
+  PutByte(writer, BINARY_COMMAND_VERSION);
+  PutByte(writer, type);
+  PutByte(writer, slot);
+  PutVarint(writer, commandId);
+  PutVarint(writer, lidTemp);
+  PutVarint(writer, sampleVolume);
+  PutInt16(writer, maxBlockOvershoot);
+  PutInt16(writer, preheatTemp);
+  PutString(writer, szName, strlen(szName));
+  PutByte(writer, numNames);
+  for (int i = 0; i < numNames; i++)
+    PutString(writer, names[i], strlen(names[i]));
+  PutByte(writer, numLoops);
+  for (uint8_t* pLoopData = loops; pLoopData < loopWriter.pData; pLoopData++)
+    PutByte(writer, *pLoopData);
+  if (writer.overflow || loopWriter.overflow)
+    return 0;
+  return writer.pData - pBuffer;
+}
+
+//START_CODE in the payload goes after ESCAPE_CODE so it does not start a packet
+void SendBinaryPacket(uint8_t type, const uint8_t* pPayload, size_t payloadLength) {
+  uint8_t packet[2 * STATUS_BUFFER_SIZE];
+  uint16_t length = sizeof(PCPPacket);
+  for (size_t i = 0; i < payloadLength; i++) {
+    if (pPayload[i] == START_CODE)
+      packet[length++] = ESCAPE_CODE;
+    packet[length++] = pPayload[i];
+  }
+
+  packet[0] = START_CODE;
+  packet[1] = length & 0xFF;
+  packet[2] = length >> 8;
+  packet[3] = type;
+  MockSerialReceive(packet, length);
+}
+
+void SendCommand(const char* szCommand, bool binary) {
+  uint8_t payload[STATUS_BUFFER_SIZE];
+  size_t length = binary ? EncodeBinaryCommand(szCommand, payload, sizeof(payload)) : 0;
+  if (length > 0)
+    SendBinaryPacket(SEND_BINARY_CMD, payload, length);
+  else
+    SendPacket(SEND_CMD, szCommand);
+}
+#else
+#define HAS_BINARY_COMMANDS false
+size_t EncodeBinaryCommand(const char* szCommand, uint8_t* pBuffer, size_t bufferSize) { return 0; }
+void SendCommand(const char* szCommand, bool binary) { SendPacket(SEND_CMD, szCommand); }
+#endif
+
+void RunLoop(const SRunnerOptions& options, SRunStats& stats) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  loop();
+  double loopNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  stats.numLoops++;
+  stats.totalLoopNs += loopNs;
+  if (loopNs > stats.maxLoopNs)
+    stats.maxLoopNs = loopNs;
+
+  MockAdvanceMillis(options.loopPeriodMs);
+}
+
+void PrintStatus() {
+  uint8_t response[STATUS_BUFFER_SIZE];
+  MockSerialTransmitted(response, sizeof(response)); //discard earlier output
+  SendPacket(STATUS_REQ, "");
+  loop();
+
+  size_t length = MockSerialTransmitted(response, sizeof(response) - 1);
+  if (length > sizeof(PCPPacket)) {
+    response[length] = '\0';
+    printf("status: %s\n", (char*)response + sizeof(PCPPacket));
+  }
+}
+
+void PrintDisplay() {
+  if (gpMockLcd == NULL)
+    return;
+
+  for (int row = 0; row < MOCK_LCD_MAX_ROWS; row++) {
+    if (gpMockLcd->GetRow(row)[0] != '\0')
+      printf("lcd: |%s|\n", gpMockLcd->GetRow(row));
+  }
+}
+
+//runs one command from power on until it completes or stops
+void RunProgram(const SRunnerOptions& options, const char* szCommand, bool binary, bool eraseEeprom, SRunStats& stats) {
+  memset(&stats, 0, sizeof(stats));
+
+  MockReset(eraseEeprom);
+  if (options.simulate) {
+    SPlantParams params = DEFAULT_PLANT_PARAMS;
+    params.sampleVolumeUl = options.sampleVolumeUl;
+    params.ambientTemp = options.ambientTemp;
+    if (options.blockCapacity > 0)
+      params.blockCapacity = options.blockCapacity;
+    spPlant = new ThermalPlant(params);
+    spStats = &stats;
+    memset(&sTracker, 0, sizeof(sTracker));
+    sLastLidPwm = 0;
+    MockSetAnalogNoise(LID_ADC_NOISE_LSB);
+    MockSetTickHook(PlantTick);
+    PlantTick(0);
+  } else {
+    MockSetAnalogInput(A1, LidAdcFromTemp(options.lidTemp));
+    MockSetPlateAdcCode(PlateAdcCodeFromTemp(options.plateTemp));
+  }
+  setup();
+
+  //let the firmware finish its startup delay, then send the program
+  while (millis() < STARTUP_WAIT_MS)
+    RunLoop(options, stats);
+  SendCommand(szCommand, binary);
+
+  unsigned long endMs = millis() + options.maxDurationS * 1000;
+  bool started = false;
+  while (millis() < endMs) {
+    RunLoop(options, stats);
+
+    Thermocycler::ProgramState state = GetThermocycler().GetProgramState();
+    if (state != Thermocycler::EStopped)
+      started = true;
+    if (state == Thermocycler::EComplete || state == Thermocycler::EError || (started && state == Thermocycler::EStopped))
+      break;
+  }
+
+  stats.simulatedMs = millis();
+  stats.finalState = GetThermocycler().GetProgramState();
+  stats.eepromWrites = MockGetEepromWrites();
+  stats.eepromStallUs = MockGetEepromStallUs();
+  if (options.verbose) {
+    PrintStatus();
+    PrintDisplay();
+  }
+
+  MockSetTickHook(NULL);
+  delete gpThermocycler;
+  gpThermocycler = NULL;
+  delete spPlant;
+  spPlant = NULL;
+}
+
+void PrintClosedLoopStats(const SRunStats& stats) {
+  unsigned long lidWaitMs = stats.programStartMs > stats.lidWaitStartMs ? stats.programStartMs - stats.lidWaitStartMs : 0;
+  unsigned long programMs = stats.programEndMs > stats.programStartMs ? stats.programEndMs - stats.programStartMs : 0;
+
+  printf("  lid wait %.1f s, program %.1f s, %lu transitions, mean ramp %.1f s\n", lidWaitMs / 1000.0, programMs / 1000.0,
+    stats.numTransitions, stats.numTransitions ? stats.totalRampMs / 1000.0 / stats.numTransitions : 0);
+  printf("  max overshoot: block %.2f C, sample %.2f C\n", stats.maxBlockOvershoot, stats.maxSampleOvershoot);
+  printf("  lid pwm travel %.0f counts/s while running, block %.2f C above the lid while it heated\n",
+    stats.runningMs ? stats.lidPwmTravel * 1000.0 / stats.runningMs : 0, stats.maxLidWaitPlateExcess);
+  printf("  plate reading against block: mean error %.2f C, max %.2f C\n",
+    stats.runningMs ? stats.totalPlateError / stats.runningMs : 0, stats.maxPlateError);
+#ifdef PLATE_GAIN_BANDS
+  printf("  sample estimate against tube: mean error %.2f C, max %.2f C\n",
+    stats.runningMs ? stats.totalSampleError / stats.runningMs : 0, stats.maxSampleError);
+#endif
+  printf("  tube at hold start: mean %.2f C short of the step, max %.2f C\n",
+    stats.numHolds ? stats.totalHoldShortfall / stats.numHolds : 0, stats.maxHoldShortfall);
+  printf("  tube within %.1f C of the step: mean %.1f s into the transition\n", SETTLE_TOLERANCE,
+    stats.numSampleArrivals ? stats.totalSampleArrivalMs / 1000.0 / stats.numSampleArrivals : 0);
+
+  //time remaining the firmware reported against what the program still took
+  if (stats.programEndMs > stats.programStartMs && stats.numEtaSamples > ETA_REPORT_S) {
+    double programS = (stats.programEndMs - stats.programStartMs) / 1000.0;
+    double totalError = 0;
+    for (unsigned long i = 0; i < stats.numEtaSamples; i++)
+      totalError += fabs(sEtaS[i] - (programS - i));
+    printf("  time remaining: error %+.0f s after %d s, %+.0f s at 10%%, mean %.0f s\n", sEtaS[ETA_REPORT_S] - (programS - ETA_REPORT_S),
+      ETA_REPORT_S, sEtaS[stats.numEtaSamples / 10] - (programS - stats.numEtaSamples / 10), totalError / stats.numEtaSamples);
+  }
+
+  //early against late transitions shows what carries over from one cycle to the next
+  if (stats.numSettled >= 2 * SETTLE_REPORT_TRANSITIONS) {
+    unsigned long firstMs = 0, lastMs = 0;
+    for (int i = 0; i < SETTLE_REPORT_TRANSITIONS; i++) {
+      firstMs += stats.settleMs[i];
+      lastMs += stats.settleMs[stats.numSettled - 1 - i];
+    }
+    printf("  settle from %.1f C to %.1f C: first %d transitions %.2f s, last %d %.2f s\n", SETTLE_BAND, SETTLE_TOLERANCE,
+      SETTLE_REPORT_TRANSITIONS, firstMs / 1000.0 / SETTLE_REPORT_TRANSITIONS, SETTLE_REPORT_TRANSITIONS, lastMs / 1000.0 / SETTLE_REPORT_TRANSITIONS);
+  }
+}
+
+//only the fixed point firmware has the plate autotune
+#ifdef PLATE_GAIN_BANDS
+#define HAS_PLATE_AUTOTUNE true
+void PrintPlateGains() {
+  SPlateGainSchedule gains;
+  if (!ProgramStore::RetrievePlateGains(gains)) {
+    printf("  no plate gains stored\n");
+    return;
+  }
+  for (int band = 0; band < PLATE_GAIN_BANDS; band++) {
+    printf("  point %6.2f C: heating kP %6ld kI %6ld kD %6ld, cooling kP %6ld kI %6ld kD %6ld\n", Degrees(gains.heating[band].temp),
+      gains.heating[band].kP, gains.heating[band].kI, gains.heating[band].kD, gains.cooling[band].kP, gains.cooling[band].kI, gains.cooling[band].kD);
+  }
+}
+#else
+#define HAS_PLATE_AUTOTUNE false
+void PrintPlateGains() {}
+#endif
+
+//and the ramp model it learns
+#ifdef RAMP_MODEL_BANDS
+void PrintRampModel() {
+  SRampModel model;
+  if (!ProgramStore::RetrieveRampModel(model))
+    return;
+  printf("  ramp model ms/C from %4.0f C:", 0.0);
+  for (int band = 0; band < RAMP_MODEL_BANDS; band++)
+    printf(" %4u/%-4u", model.heatingMsPerDegree[band], model.coolingMsPerDegree[band]);
+  printf("\n  ramp model settle: heating %d ms, cooling %d ms\n", model.heatingSettleMs, model.coolingSettleMs);
+}
+#else
+void PrintRampModel() {}
+#endif
+
+void Usage(const char* szName) {
+  fprintf(stderr, "usage: %s [-p program] [-t loopPeriodMs] [-d maxDurationS] [-l lidC] [-b plateC] [-n runs] [-v] [-B]\n"
+                  "          [-s [-V sampleVolumeUl] [-a ambientC] [-m blockJperK] [-T]]\n"
+                  "  -l, -b  fixed sensor temperatures, used without -s\n"
+                  "  -s      close the loop through the lumped thermal plant model\n"
+                  "  -m      block heat capacity, another unit than the one the firmware was tuned on\n"
+                  "  -T      autotune the plate gains first, then run with the gains it stored\n"
+                  "  -n      runs on the same unit, keeping what earlier runs stored in EEPROM\n"
+                  "  -B      send the program as a binary command\n", szName);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  SRunnerOptions options = { DEFAULT_PROGRAM, 50, 4 * 3600, 110, 95, 1, false, false, 20, 25, 0, false, false };
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:t:d:l:b:n:vsV:a:m:TB")) != -1) {
+    switch (opt) {
+    case 'p': options.szProgram = optarg; break;
+    case 't': options.loopPeriodMs = strtoul(optarg, NULL, 10); break;
+    case 'd': options.maxDurationS = strtoul(optarg, NULL, 10); break;
+    case 'l': options.lidTemp = atof(optarg); break;
+    case 'b': options.plateTemp = atof(optarg); break;
+    case 'n': options.numRuns = atoi(optarg); break;
+    case 'v': options.verbose = true; break;
+    case 's': options.simulate = true; break;
+    case 'V': options.sampleVolumeUl = atof(optarg); break;
+    case 'a': options.ambientTemp = atof(optarg); break;
+    case 'm': options.blockCapacity = atof(optarg); break;
+    case 'T': options.autotune = true; break;
+    case 'B': options.binary = true; break;
+    default: Usage(argv[0]);
+    }
+  }
+  if (options.loopPeriodMs == 0 || options.numRuns < 1 || (options.autotune && (!options.simulate || !HAS_PLATE_AUTOTUNE)) ||
+      (options.binary && !HAS_BINARY_COMMANDS))
+    Usage(argv[0]);
+
+  if (options.binary && options.verbose) {
+    uint8_t payload[STATUS_BUFFER_SIZE];
+    printf("command: %zu bytes as text, %zu as binary\n", strlen(options.szProgram),
+      EncodeBinaryCommand(options.szProgram, payload, sizeof(payload)));
+  }
+
+  if (options.autotune) {
+    SRunStats stats;
+    RunProgram(options, AUTOTUNE_COMMAND, false, true, stats);
+    printf("autotune: %s after %.1f s\n", stats.finalState == Thermocycler::EStopped ? "gains stored" : "failed",
+      (stats.simulatedMs - STARTUP_WAIT_MS) / 1000.0);
+    if (options.verbose)
+      PrintPlateGains();
+    if (stats.finalState != Thermocycler::EStopped)
+      return 2;
+  }
+
+  unsigned long totalLoops = 0;
+  double totalLoopNs = 0, maxLoopNs = 0;
+  double totalProgramS = 0, maxBlockOvershoot = 0, maxSampleOvershoot = 0;
+  double totalLidWaitS = 0, totalLidPwmTravel = 0;
+  unsigned long totalEepromWrites = 0, maxEepromStallUs = 0;
+  int completedRuns = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (int run = 0; run < options.numRuns; run++) {
+    SRunStats stats;
+    RunProgram(options, options.szProgram, options.binary, !options.autotune && run == 0, stats); //later runs on the same unit
+
+    totalLoops += stats.numLoops;
+    totalLoopNs += stats.totalLoopNs;
+    if (stats.maxLoopNs > maxLoopNs)
+      maxLoopNs = stats.maxLoopNs;
+    if (stats.finalState == Thermocycler::EComplete)
+      completedRuns++;
+    totalEepromWrites += stats.eepromWrites;
+    if (stats.eepromStallUs > maxEepromStallUs)
+      maxEepromStallUs = stats.eepromStallUs;
+    totalProgramS += (stats.programEndMs - stats.programStartMs) / 1000.0;
+    totalLidWaitS += (stats.programStartMs - stats.lidWaitStartMs) / 1000.0;
+    totalLidPwmTravel += stats.runningMs ? stats.lidPwmTravel * 1000.0 / stats.runningMs : 0;
+    if (stats.maxBlockOvershoot > maxBlockOvershoot)
+      maxBlockOvershoot = stats.maxBlockOvershoot;
+    if (stats.maxSampleOvershoot > maxSampleOvershoot)
+      maxSampleOvershoot = stats.maxSampleOvershoot;
+
+    if (options.verbose) {
+      printf("run %d: state %d after %.1f s simulated, %lu loops\n", run + 1, stats.finalState, stats.simulatedMs / 1000.0, stats.numLoops);
+      if (options.simulate)
+        PrintClosedLoopStats(stats);
+      PrintRampModel();
+    }
+  }
+
+  double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("runs: %d (%d complete) in %.3f s wall\n", options.numRuns, completedRuns, wallS);
+  printf("Loop(): %lu calls, mean %.0f ns, max %.0f ns\n", totalLoops, totalLoops ? totalLoopNs / totalLoops : 0, maxLoopNs);
+  printf("eeprom: %lu bytes written, up to %.1f ms a run waiting on writes\n", totalEepromWrites, maxEepromStallUs / 1000.0);
+  if (options.simulate)
+    printf("closed loop: mean program %.1f s, max overshoot block %.2f C, sample %.2f C\n",
+      totalProgramS / options.numRuns, maxBlockOvershoot, maxSampleOvershoot);
+  if (options.simulate)
+    printf("lid: mean wait %.1f s, pwm travel %.0f counts/s while running\n",
+      totalLidWaitS / options.numRuns, totalLidPwmTravel / options.numRuns);
+
+  return completedRuns == options.numRuns ? 0 : 2;
+}
@@ -0,0 +1,38 @@
+/*
+ *  Wire.h - host build mock of the Arduino Wire (TWI) library.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MOCK_WIRE_H_
+#define _MOCK_WIRE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+class TwoWire {
+public:
+  void begin();
+  void setClock(uint32_t hz);
+  void beginTransmission(uint8_t address);
+  uint8_t endTransmission();
+  uint8_t requestFrom(uint8_t address, uint8_t quantity);
+  size_t write(uint8_t data);
+  int available();
+  int read();
+};
+
+extern TwoWire Wire;
+
+#endif
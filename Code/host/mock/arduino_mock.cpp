@@ -0,0 +1,538 @@
+/*
+ *  arduino_mock.cpp - host build mock of the Arduino core for OpenPCR.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include <avr/interrupt.h>
+#include "EEPROM.h"
+#include "LiquidCrystal.h"
+#include "../Wire/Wire.h"
+#include "mockhal.h"
+
+#define MOCK_SERIAL_BUFFER_SIZE 4096
+#define MOCK_SS_PIN 10
+#define MOCK_MISO_PIN 12
+#define MOCK_PLATE_CONVERSION_MS 133 //LTC2400 class converter, 60 Hz rejection
+#define MOCK_POLL_US 5                //cost of one digitalRead() in a spin loop
+#define MOCK_TIMER1_OVERFLOW_US 1023 //10 bit phase correct PWM at clk/8
+#define MOCK_TIMER0_OVERFLOW_US 1024 //Arduino core millis() timer, fast PWM at clk/64
+#define MOCK_ADC_MAX_CODE 1023
+#define MOCK_ADTS_MASK 0x07
+#define MOCK_ADTS_TIMER0_OVERFLOW 0x04
+#define MOCK_MCP342X_ADDRESS 0x68
+#define MOCK_MCP342X_READY 0x80      //write: start a conversion, read: output not ready
+#define MOCK_MCP342X_CONTINUOUS 0x10
+#define MOCK_MCP342X_RES_SHIFT 2
+#define MOCK_MCP342X_FRAME_BYTES 4
+#define MOCK_EEPROM_WRITE_US 3400     //erase and write of one byte
+
+// register file
+volatile uint8_t MCUSR;
+volatile uint8_t SPCR;
+volatile uint8_t SPSR;
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint8_t TIMSK1;
+volatile uint8_t TCCR2A;
+volatile uint8_t TCCR2B;
+volatile uint8_t ADMUX;
+volatile uint8_t ADCSRA;
+volatile uint8_t ADCSRB;
+volatile uint8_t DIDR0;
+volatile uint16_t ADC;
+volatile uint8_t EECR;
+MockSpiDataRegister SPDR;
+
+// avr-libc heap internals referenced by util.cpp
+struct __freelist;
+struct __freelist* __flp = NULL;
+uint8_t* __brkval = NULL;
+
+unsigned long gMockProgmemReads = 0;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+TwoWire Wire;
+LiquidCrystal* gpMockLcd = NULL;
+
+static unsigned long sMillis = 0;
+static unsigned long sTimer1Us = 0;
+static bool sTimer1Pending = false;
+static unsigned long sTimer0Us = 0;
+static bool sInterruptsEnabled = true;
+static TMockTickHook spTickHook = NULL;
+static int sDigital[MOCK_NUM_PINS];
+static double sAnalogIn[MOCK_NUM_PINS];
+static double sAnalogNoise = 0;
+static unsigned long sNoiseSeed = 1;
+static int sAnalogOut[MOCK_NUM_PINS];
+static uint8_t sEeprom[E2END + 1];
+static unsigned long sEepromReadyUs = 0; //the byte being written is done
+static unsigned long sEepromWaitedUs = 0; //the firmware already waited this long
+static unsigned long sEepromWrites = 0;
+static unsigned long sEepromStallUs = 0;
+
+static uint32_t sPlateAdcCode = 0;
+static uint8_t sSpiFrame[4];
+static int sSpiIndex = 0;
+static uint8_t sSpiData = 0;
+static unsigned long sPlateConversionDoneMs = 0;
+static unsigned long sSpinUs = 0;
+
+//12, 14, 16 and 18 bit conversion times (240, 60, 15 and 3.75 SPS)
+static const unsigned long MOCK_MCP342X_CONVERSION_MS[] = { 5, 17, 67, 267 };
+static uint8_t sTwiAddress = 0;
+static uint8_t sTwiTx = 0;
+static uint8_t sTwiRx[MOCK_MCP342X_FRAME_BYTES];
+static int sTwiRxLength = 0;
+static int sTwiRxIndex = 0;
+static uint8_t sMcpConfig = 0;
+static int32_t sMcpOutput = 0;
+static unsigned long sMcpConversionDoneMs = 0;
+static bool sMcpConverting = false;
+
+static uint8_t sRxBuffer[MOCK_SERIAL_BUFFER_SIZE];
+static size_t sRxHead = 0, sRxTail = 0;
+static uint8_t sTxBuffer[MOCK_SERIAL_BUFFER_SIZE];
+static size_t sTxLength = 0;
+
+////////////////////////////////////////////////////////////////////
+// Host controls
+void MockReset(bool eraseEeprom) {
+  sMillis = 0;
+  sTimer1Us = 0;
+  sTimer1Pending = false;
+  sTimer0Us = 0;
+  sInterruptsEnabled = true;
+  MCUSR = _BV(PORF);
+  SPCR = 0;
+  SPSR = _BV(SPIF); //transfers complete immediately
+  TCCR1A = TCCR1B = TCCR2A = TCCR2B = 0;
+  TIMSK1 = 0;
+  ADMUX = ADCSRA = ADCSRB = DIDR0 = 0;
+  ADC = 0;
+  memset(sDigital, 0, sizeof(sDigital));
+  memset(sAnalogIn, 0, sizeof(sAnalogIn));
+  sAnalogNoise = 0;
+  sNoiseSeed = 1;
+  memset(sAnalogOut, 0, sizeof(sAnalogOut));
+  sSpiIndex = 0;
+  sPlateConversionDoneMs = MOCK_PLATE_CONVERSION_MS;
+  sSpinUs = 0;
+  sTwiRxLength = sTwiRxIndex = 0;
+  sMcpConfig = 0;
+  sMcpOutput = 0;
+  sMcpConverting = false;
+  sRxHead = sRxTail = 0;
+  sTxLength = 0;
+  if (eraseEeprom)
+    memset(sEeprom, 0xFF, sizeof(sEeprom));
+  EECR = 0;
+  sEepromReadyUs = 0;
+  sEepromWaitedUs = 0;
+  sEepromWrites = 0;
+  sEepromStallUs = 0;
+}
+
+//one ADC conversion of an analog input: level plus gaussian noise, rounded and clamped like the converter
+static int SampleAnalogInput(uint8_t pin) {
+  double value = sAnalogIn[pin];
+  if (sAnalogNoise > 0) {
+    //Box-Muller over a fixed seed, so every run sees the same noise
+    sNoiseSeed = sNoiseSeed * 1103515245 + 12345;
+    double u1 = ((sNoiseSeed >> 8) % 65535 + 1) / 65536.0;
+    sNoiseSeed = sNoiseSeed * 1103515245 + 12345;
+    double u2 = ((sNoiseSeed >> 8) % 65536) / 65536.0;
+    value += sAnalogNoise * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+  }
+  int code = (int)floor(value + 0.5);
+  return code < 0 ? 0 : code > MOCK_ADC_MAX_CODE ? MOCK_ADC_MAX_CODE : code;
+}
+
+//Timer0 overflow is an ADC auto trigger source; the conversion lands within the same millisecond
+static void TriggerAdc() {
+  if (!(ADCSRA & _BV(ADEN)) || !(ADCSRA & _BV(ADATE)) || (ADCSRB & MOCK_ADTS_MASK) != MOCK_ADTS_TIMER0_OVERFLOW)
+    return;
+
+  ADC = SampleAnalogInput(A0 + (ADMUX & 0x07));
+  ADCSRA |= _BV(ADIF);
+}
+
+//runs pending interrupt handlers the way the AVR does: interrupts off inside them,
+//lower vector numbers (ADC before Timer1 overflow) first
+static void DispatchInterrupts() {
+  if (!sInterruptsEnabled)
+    return;
+
+  if ((ADCSRA & _BV(ADIF)) && (ADCSRA & _BV(ADIE)) && ADC_vect != NULL) {
+    ADCSRA &= ~_BV(ADIF);
+    sInterruptsEnabled = false;
+    ADC_vect();
+    sInterruptsEnabled = true;
+  }
+  
+  if (sTimer1Pending && (TIMSK1 & _BV(TOIE1)) && TIMER1_OVF_vect != NULL) {
+    sTimer1Pending = false;
+    sInterruptsEnabled = false;
+    TIMER1_OVF_vect();
+    sInterruptsEnabled = true;
+  }
+  
+  //level triggered, again as long as the handler leaves the EEPROM ready
+  while ((EECR & _BV(EERIE)) && sEepromReadyUs <= sMillis * 1000 && EE_READY_vect != NULL) {
+    sInterruptsEnabled = false;
+    EE_READY_vect();
+    sInterruptsEnabled = true;
+  }
+}
+
+void MockAdvanceMillis(unsigned long ms) {
+  while (ms--) {
+    sMillis++;
+    if (spTickHook)
+      spTickHook(sMillis);
+
+    for (sTimer0Us += 1000; sTimer0Us >= MOCK_TIMER0_OVERFLOW_US; sTimer0Us -= MOCK_TIMER0_OVERFLOW_US) {
+      TriggerAdc();
+      DispatchInterrupts();
+    }
+    for (sTimer1Us += 1000; sTimer1Us >= MOCK_TIMER1_OVERFLOW_US; sTimer1Us -= MOCK_TIMER1_OVERFLOW_US) {
+      sTimer1Pending = true;
+      DispatchInterrupts();
+    }
+  }
+}
+
+void MockSetTickHook(TMockTickHook pHook) {
+  spTickHook = pHook;
+}
+
+void MockSetAnalogInput(uint8_t pin, double value) {
+  sAnalogIn[pin] = value;
+}
+
+void MockSetAnalogNoise(double lsbRms) {
+  sAnalogNoise = lsbRms;
+}
+
+void MockSetPlateAdcCode(uint32_t conv) {
+  sPlateAdcCode = conv & 0x1FFFFF;
+}
+
+int MockGetDigitalOutput(uint8_t pin) {
+  return sDigital[pin];
+}
+
+int MockGetAnalogOutput(uint8_t pin) {
+  return sAnalogOut[pin];
+}
+
+void MockSerialReceive(const uint8_t* pData, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    sRxBuffer[sRxHead] = pData[i];
+    sRxHead = (sRxHead + 1) % MOCK_SERIAL_BUFFER_SIZE;
+  }
+}
+
+size_t MockSerialTransmitted(uint8_t* pBuffer, size_t maxLength) {
+  size_t length = sTxLength < maxLength ? sTxLength : maxLength;
+  memcpy(pBuffer, sTxBuffer, length);
+  sTxLength = 0;
+  return length;
+}
+
+uint8_t* MockGetEeprom() {
+  return sEeprom;
+}
+
+unsigned long MockGetEepromWrites() {
+  return sEepromWrites;
+}
+
+unsigned long MockGetEepromStallUs() {
+  return sEepromStallUs;
+}
+
+////////////////////////////////////////////////////////////////////
+// Interrupts
+void sei() {
+  sInterruptsEnabled = true;
+}
+
+void cli() {
+  sInterruptsEnabled = false;
+}
+
+bool MockInterruptsEnabled() {
+  return sInterruptsEnabled;
+}
+
+////////////////////////////////////////////////////////////////////
+// Arduino core
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  //a falling slave select latches the next plate ADC frame
+  if (pin == MOCK_SS_PIN && val == LOW) {
+    sSpiFrame[0] = 0x20 | ((sPlateAdcCode >> 17) & 0x0F); //SIG set, the input is positive
+    sSpiFrame[1] = (sPlateAdcCode >> 9) & 0xFF;
+    sSpiFrame[2] = (sPlateAdcCode >> 1) & 0xFF;
+    sSpiFrame[3] = (sPlateAdcCode & 0x01) << 7;
+    sSpiIndex = 0;
+  }
+  
+  //deselecting after a read starts the next conversion
+  if (pin == MOCK_SS_PIN && val == HIGH && sSpiIndex == 4)
+    sPlateConversionDoneMs = sMillis + MOCK_PLATE_CONVERSION_MS;
+  sDigital[pin] = val;
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin != MOCK_MISO_PIN || sMillis >= sPlateConversionDoneMs)
+    return LOW;
+
+  //plate ADC still converting; firmware that spins on this burns real time
+  sSpinUs += MOCK_POLL_US;
+  if (sSpinUs >= 1000) {
+    sSpinUs -= 1000;
+    MockAdvanceMillis(1);
+  }
+  return HIGH;
+}
+
+int analogRead(uint8_t pin) {
+  if (pin < A0)
+    pin += A0;
+  return SampleAnalogInput(pin);
+}
+
+void analogWrite(uint8_t pin, int val) {
+  sAnalogOut[pin] = val;
+}
+
+unsigned long millis() {
+  return sMillis;
+}
+
+unsigned long micros() {
+  return sMillis * 1000;
+}
+
+void delay(unsigned long ms) {
+  MockAdvanceMillis(ms);
+}
+
+char* ltoa(long val, char* s, int radix) {
+  if (val < 0) {
+    *s = '-';
+    ultoa(-(unsigned long)val, s + 1, radix);
+  } else {
+    ultoa(val, s, radix);
+  }
+  return s;
+}
+
+char* itoa(int val, char* s, int radix) {
+  return ltoa(val, s, radix);
+}
+
+char* ultoa(unsigned long val, char* s, int radix) {
+  char buf[8 * sizeof(long) + 1];
+  char* p = buf;
+  do {
+    int digit = val % radix;
+    *p++ = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    val /= radix;
+  } while (val);
+
+  char* pOut = s;
+  while (p != buf)
+    *pOut++ = *--p;
+  *pOut = '\0';
+  return s;
+}
+
+////////////////////////////////////////////////////////////////////
+// SPI
+MockSpiDataRegister& MockSpiDataRegister::operator=(uint8_t data) {
+  sSpiData = sSpiIndex < 4 ? sSpiFrame[sSpiIndex++] : 0xFF;
+  return *this;
+}
+
+MockSpiDataRegister::operator uint8_t() const {
+  return sSpiData;
+}
+
+////////////////////////////////////////////////////////////////////
+// Class HardwareSerial
+void HardwareSerial::begin(unsigned long baud) {
+}
+
+int HardwareSerial::available() {
+  return (sRxHead + MOCK_SERIAL_BUFFER_SIZE - sRxTail) % MOCK_SERIAL_BUFFER_SIZE;
+}
+
+int HardwareSerial::read() {
+  if (sRxHead == sRxTail)
+    return -1;
+
+  uint8_t val = sRxBuffer[sRxTail];
+  sRxTail = (sRxTail + 1) % MOCK_SERIAL_BUFFER_SIZE;
+  return val;
+}
+
+size_t HardwareSerial::write(uint8_t val) {
+  if (sTxLength == MOCK_SERIAL_BUFFER_SIZE)
+    return 0;
+
+  sTxBuffer[sTxLength++] = val;
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  size_t written = 0;
+  while (written < size && write(buffer[written]))
+    written++;
+  return written;
+}
+
+////////////////////////////////////////////////////////////////////
+// Class EEPROMClass
+//reads and writes wait for a write in progress, the clock does not move meanwhile
+static void WaitForEeprom() {
+  unsigned long nowUs = sMillis * 1000 > sEepromWaitedUs ? sMillis * 1000 : sEepromWaitedUs;
+  if (sEepromReadyUs > nowUs) {
+    sEepromStallUs += sEepromReadyUs - nowUs;
+    sEepromWaitedUs = sEepromReadyUs;
+  }
+}
+
+uint8_t EEPROMClass::read(int address) {
+  WaitForEeprom();
+  return sEeprom[address & E2END];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  WaitForEeprom();
+  sEeprom[address & E2END] = value;
+  sEepromReadyUs = (sEepromReadyUs > sMillis * 1000 ? sEepromReadyUs : sMillis * 1000) + MOCK_EEPROM_WRITE_US;
+  sEepromWrites++;
+}
+
+////////////////////////////////////////////////////////////////////
+// Class LiquidCrystal
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3):
+  iNumCols(MOCK_LCD_MAX_COLS),
+  iNumRows(MOCK_LCD_MAX_ROWS),
+  iCol(0),
+  iRow(0) {
+  gpMockLcd = this;
+  clear();
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t rows) {
+  iNumCols = cols > MOCK_LCD_MAX_COLS ? MOCK_LCD_MAX_COLS : cols;
+  iNumRows = rows > MOCK_LCD_MAX_ROWS ? MOCK_LCD_MAX_ROWS : rows;
+  clear();
+}
+
+void LiquidCrystal::clear() {
+  for (int row = 0; row < MOCK_LCD_MAX_ROWS; row++) {
+    memset(iText[row], ' ', MOCK_LCD_MAX_COLS);
+    iText[row][row < iNumRows ? iNumCols : 0] = '\0';
+  }
+  iCol = iRow = 0;
+}
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row) {
+  iCol = col;
+  iRow = row;
+}
+
+void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
+}
+
+void LiquidCrystal::print(const char* str) {
+  while (*str) {
+    if (iRow < iNumRows && iCol < iNumCols)
+      iText[iRow][iCol] = *str;
+    iCol++;
+    str++;
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+// Class TwoWire, with an MCP3422 at its base address measuring the plate divider
+//the plate ADC code is the divider ratio; here the divider is excited from the 2.048 V full scale
+static void McpLatchConversion() {
+  if (!sMcpConverting || sMillis < sMcpConversionDoneMs)
+    return;
+
+  int resolution = (sMcpConfig >> MOCK_MCP342X_RES_SHIFT) & 0x03;
+  sMcpOutput = (int32_t)(sPlateAdcCode >> 4) >> (6 - 2 * resolution);
+  sMcpConverting = false;
+}
+
+void TwoWire::begin() {
+}
+
+void TwoWire::setClock(uint32_t hz) {
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  sTwiAddress = address;
+}
+
+uint8_t TwoWire::endTransmission() {
+  if (sTwiAddress != MOCK_MCP342X_ADDRESS)
+    return 2; //address NACK
+
+  sMcpConfig = sTwiTx;
+  if ((sMcpConfig & MOCK_MCP342X_READY) || (sMcpConfig & MOCK_MCP342X_CONTINUOUS)) {
+    sMcpConverting = true;
+    sMcpConversionDoneMs = sMillis + MOCK_MCP342X_CONVERSION_MS[(sMcpConfig >> MOCK_MCP342X_RES_SHIFT) & 0x03];
+  }
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+  sTwiRxLength = sTwiRxIndex = 0;
+  if (address != MOCK_MCP342X_ADDRESS)
+    return 0;
+
+  //data bytes, big endian and sign extended, then the configuration byte repeated
+  McpLatchConversion();
+  int numDataBytes = ((sMcpConfig >> MOCK_MCP342X_RES_SHIFT) & 0x03) == 3 ? 3 : 2;
+  uint8_t config = (sMcpConfig & ~MOCK_MCP342X_READY) | (sMcpConverting ? MOCK_MCP342X_READY : 0);
+  for (int i = 0; i < MOCK_MCP342X_FRAME_BYTES; i++)
+    sTwiRx[i] = i < numDataBytes ? (sMcpOutput >> (8 * (numDataBytes - 1 - i))) & 0xFF : config;
+  sTwiRxLength = quantity < MOCK_MCP342X_FRAME_BYTES ? quantity : MOCK_MCP342X_FRAME_BYTES;
+  return sTwiRxLength;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  sTwiTx = data;
+  return 1;
+}
+
+int TwoWire::available() {
+  return sTwiRxLength - sTwiRxIndex;
+}
+
+int TwoWire::read() {
+  return sTwiRxIndex < sTwiRxLength ? sTwiRx[sTwiRxIndex++] : -1;
+}
@@ -0,0 +1,47 @@
+/*
+ *  LiquidCrystal.h - host build mock of the Arduino LiquidCrystal library.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MOCK_LIQUIDCRYSTAL_H_
+#define _MOCK_LIQUIDCRYSTAL_H_
+
+#include <stdint.h>
+
+#define MOCK_LCD_MAX_COLS 20
+#define MOCK_LCD_MAX_ROWS 4
+
+//character buffer only, so the host runner can dump what the unit would show
+class LiquidCrystal {
+public:
+  LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
+
+  void begin(uint8_t cols, uint8_t rows);
+  void clear();
+  void setCursor(uint8_t col, uint8_t row);
+  void createChar(uint8_t location, uint8_t charmap[]);
+  void print(const char* str);
+
+  const char* GetRow(uint8_t row) { return iText[row]; }
+
+private:
+  uint8_t iNumCols, iNumRows;
+  uint8_t iCol, iRow;
+  char iText[MOCK_LCD_MAX_ROWS][MOCK_LCD_MAX_COLS + 1];
+};
+
+extern LiquidCrystal* gpMockLcd;
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ *  avr/interrupt.h - host build mock of avr-libc interrupt handling.
+ *
+ *  ISR() handlers become plain C functions; arduino_mock.cpp calls them as the
+ *  simulated clock advances, honouring the global interrupt flag and the
+ *  per-source enable bits.
+ */
+
+#ifndef _MOCK_AVR_INTERRUPT_H_
+#define _MOCK_AVR_INTERRUPT_H_
+
+#define ISR(vector, ...) extern "C" void vector(void)
+
+void sei(void);
+void cli(void);
+
+extern "C" void TIMER1_OVF_vect(void) __attribute__((weak));
+extern "C" void ADC_vect(void) __attribute__((weak));
+extern "C" void EE_READY_vect(void) __attribute__((weak));
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ *  avr/io.h - host build mock of the ATmega register file.
+ *
+ *  Only the registers and bits touched by the OpenPCR firmware are modelled.
+ *  Plain registers are ordinary variables; SPDR is routed to the simulated
+ *  plate ADC and ADC is written by the simulated lid ADC in arduino_mock.cpp.
+ *  EECR only gates the EEPROM ready interrupt, the EEPROM library does the rest.
+ */
+
+#ifndef _MOCK_AVR_IO_H_
+#define _MOCK_AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+// reset status
+extern volatile uint8_t MCUSR;
+#define PORF 0
+
+// SPI
+class MockSpiDataRegister {
+public:
+  MockSpiDataRegister& operator=(uint8_t data);
+  operator uint8_t() const;
+};
+
+extern volatile uint8_t SPCR;
+extern volatile uint8_t SPSR;
+extern MockSpiDataRegister SPDR;
+
+#define SPR0 0
+#define SPR1 1
+#define CPHA 2
+#define CPOL 3
+#define MSTR 4
+#define DORD 5
+#define SPE  6
+#define SPIE 7
+#define SPIF 7
+
+// timers
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint8_t TIMSK1;
+extern volatile uint8_t TCCR2A;
+extern volatile uint8_t TCCR2B;
+
+#define WGM10 0
+#define WGM11 1
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define TOIE1 0
+
+#define WGM20 0
+#define WGM21 1
+#define COM2B0 4
+#define COM2B1 5
+#define COM2A0 6
+#define COM2A1 7
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define WGM22 3
+
+// ADC
+extern volatile uint8_t ADMUX;
+extern volatile uint8_t ADCSRA;
+extern volatile uint8_t ADCSRB;
+extern volatile uint8_t DIDR0;
+extern volatile uint16_t ADC;
+
+#define MUX0 0
+#define MUX1 1
+#define MUX2 2
+#define MUX3 3
+#define ADLAR 5
+#define REFS0 6
+#define REFS1 7
+
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADATE 5
+#define ADSC 6
+#define ADEN 7
+
+#define ADTS0 0
+#define ADTS1 1
+#define ADTS2 2
+
+#define ADC0D 0
+#define ADC1D 1
+#define ADC2D 2
+#define ADC3D 3
+#define ADC4D 4
+#define ADC5D 5
+
+// EEPROM
+extern volatile uint8_t EECR;
+
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+
+#endif
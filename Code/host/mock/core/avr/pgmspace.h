@@ -0,0 +1,35 @@
+/*
+ *  avr/pgmspace.h - host build mock of avr-libc program memory access.
+ *
+ *  On the host, flash and RAM share one address space, so PROGMEM data is
+ *  read with plain dereferences.  Every read is counted so host benchmarks can
+ *  report the number of flash accesses a routine makes on the AVR.
+ */
+
+#ifndef _MOCK_AVR_PGMSPACE_H_
+#define _MOCK_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+extern unsigned long gMockProgmemReads;
+
+#define pgm_read_byte_near(addr) (gMockProgmemReads++, *(addr))
+#define pgm_read_word_near(addr) (gMockProgmemReads++, *(addr))
+#define pgm_read_dword_near(addr) (gMockProgmemReads++, *(addr))
+#define pgm_read_byte(addr) pgm_read_byte_near(addr)
+#define pgm_read_word(addr) pgm_read_word_near(addr)
+#define pgm_read_dword(addr) pgm_read_dword_near(addr)
+
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strncmp_P strncmp
+#define strlen_P strlen
+#define sprintf_P sprintf
+#define memcpy_P memcpy
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ *  util/atomic.h - host build mock of the avr-libc atomic block macros.
+ */
+
+#ifndef _MOCK_UTIL_ATOMIC_H_
+#define _MOCK_UTIL_ATOMIC_H_
+
+#include <avr/interrupt.h>
+
+bool MockInterruptsEnabled();
+
+//disables interrupts for one pass of the loop body, then restores the old state
+class MockAtomicGuard {
+public:
+  MockAtomicGuard(): iWasEnabled(MockInterruptsEnabled()), iDone(false) { cli(); }
+  ~MockAtomicGuard() { if (iWasEnabled) sei(); }
+  bool Once() { bool first = !iDone; iDone = true; return first; }
+
+private:
+  bool iWasEnabled;
+  bool iDone;
+};
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (MockAtomicGuard _atomicGuard; _atomicGuard.Once(); )
+
+#endif
@@ -0,0 +1,18 @@
+/*
+ *  util/crc16.h - host build mock of the avr-libc CRC routines.
+ */
+
+#ifndef _MOCK_UTIL_CRC16_H_
+#define _MOCK_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+//CRC-16, polynomial 0xA001 reflected, the C equivalent avr-libc documents
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a) {
+  crc ^= a;
+  for (int i = 0; i < 8; i++)
+    crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+  return crc;
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ *  mockhal.h - host side controls for the mock Arduino HAL.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MOCKHAL_H_
+#define _MOCKHAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MOCK_NUM_PINS 32
+
+//called once per simulated millisecond while the clock advances
+typedef void (*TMockTickHook)(unsigned long nowMs);
+
+// power-on reset: clock to 0, pins cleared, serial flushed, EEPROM erased if requested
+void MockReset(bool eraseEeprom);
+
+// time
+void MockAdvanceMillis(unsigned long ms);
+void MockSetTickHook(TMockTickHook pHook);
+
+// sensors
+void MockSetAnalogInput(uint8_t pin, double value); //in ADC codes, fractions resolve under noise
+void MockSetAnalogNoise(double lsbRms);              //gaussian noise added to every ADC sample
+void MockSetPlateAdcCode(uint32_t conv); //21 bit LTC24xx conversion result, also scaled into the MCP342x
+
+// actuators
+int MockGetDigitalOutput(uint8_t pin);
+int MockGetAnalogOutput(uint8_t pin);
+
+// serial
+void MockSerialReceive(const uint8_t* pData, size_t length);
+size_t MockSerialTransmitted(uint8_t* pBuffer, size_t maxLength); //drains transmit queue
+
+// persistent storage
+uint8_t* MockGetEeprom();
+unsigned long MockGetEepromWrites();  //bytes written since reset
+unsigned long MockGetEepromStallUs(); //the firmware waited on a write in progress
+
+#endif
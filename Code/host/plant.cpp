@@ -0,0 +1,75 @@
+/*
+ *  plant.cpp - lumped-parameter thermal model of the OpenPCR hardware.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "plant.h"
+
+#define KELVIN_OFFSET 273.15
+#define WATER_HEAT_CAPACITY 4.18e-3 // J/(K*uL)
+#define TUBE_HEAT_CAPACITY 0.05     // J/K, polypropylene wall of a 0.2 mL tube
+
+const SPlantParams DEFAULT_PLANT_PARAMS = {
+  25.0,                   //ambientTemp
+  40.0, 0.05,             //blockCapacity, blockLoss
+  0.053, 2.0, 0.5, 4.0,   //peltierSeebeck, peltierResistance, peltierConductance, peltierMaxCurrent
+  300.0, 3.0,             //sinkCapacity, sinkLoss
+  20.0, 0.02,             //sampleVolumeUl, sampleConductance
+  30.0, 0.15, 0.02, 20.0, //lidCapacity, lidLoss, lidBlockCoupling, lidHeaterPower
+  1.5, 2.0                //plateSensorTau, lidSensorTau
+};
+
+////////////////////////////////////////////////////////////////////
+// Class ThermalPlant
+ThermalPlant::ThermalPlant(const SPlantParams& params):
+  iParams(params) {
+  Reset();
+}
+
+void ThermalPlant::Reset() {
+  //larger samples hold more heat but also sit deeper in the well
+  iSampleCapacity = TUBE_HEAT_CAPACITY + WATER_HEAT_CAPACITY * iParams.sampleVolumeUl;
+  iSampleConductance = iParams.sampleConductance * (1.0 + iParams.sampleVolumeUl / 40.0);
+
+  iBlockTemp = iSinkTemp = iSampleTemp = iLidTemp = iParams.ambientTemp;
+  iPlateSensorTemp = iLidSensorTemp = iParams.ambientTemp;
+}
+
+void ThermalPlant::Step(double dtS, double peltierDrive, double lidDrive) {
+  //Peltier module: positive current pumps heat out of the block into the sink
+  double current = -peltierDrive * iParams.peltierMaxCurrent;
+  double blockK = iBlockTemp + KELVIN_OFFSET;
+  double sinkK = iSinkTemp + KELVIN_OFFSET;
+  double joule = 0.5 * current * current * iParams.peltierResistance;
+  double conduction = iParams.peltierConductance * (iSinkTemp - iBlockTemp);
+
+  double sampleFlow = iSampleConductance * (iBlockTemp - iSampleTemp);
+  double lidFlow = iParams.lidBlockCoupling * (iLidTemp - iBlockTemp);
+
+  double blockPower = -iParams.peltierSeebeck * current * blockK + joule + conduction
+                      - iParams.blockLoss * (iBlockTemp - iParams.ambientTemp) - sampleFlow + lidFlow;
+  double sinkPower = iParams.peltierSeebeck * current * sinkK + joule - conduction
+                     - iParams.sinkLoss * (iSinkTemp - iParams.ambientTemp);
+  double lidPower = iParams.lidHeaterPower * lidDrive - iParams.lidLoss * (iLidTemp - iParams.ambientTemp) - lidFlow;
+
+  iBlockTemp += blockPower * dtS / iParams.blockCapacity;
+  iSinkTemp += sinkPower * dtS / iParams.sinkCapacity;
+  iSampleTemp += sampleFlow * dtS / iSampleCapacity;
+  iLidTemp += lidPower * dtS / iParams.lidCapacity;
+
+  //thermistors see their mounting point through a first order lag
+  iPlateSensorTemp += (iBlockTemp - iPlateSensorTemp) * dtS / iParams.plateSensorTau;
+  iLidSensorTemp += (iLidTemp - iLidSensorTemp) * dtS / iParams.lidSensorTau;
+}
@@ -0,0 +1,86 @@
+/*
+ *  plant.h - lumped-parameter thermal model of the OpenPCR hardware.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PLANT_H_
+#define _PLANT_H_
+
+struct SPlantParams {
+  double ambientTemp;       // C
+
+  // sample block and Peltier (TEC1-12706 class module)
+  double blockCapacity;     // J/K
+  double blockLoss;         // W/K, block to ambient
+  double peltierSeebeck;    // V/K
+  double peltierResistance; // Ohm
+  double peltierConductance;// W/K, block to heat sink through the module
+  double peltierMaxCurrent; // A at full PWM
+
+  // heat sink and fan
+  double sinkCapacity;      // J/K
+  double sinkLoss;          // W/K, heat sink to ambient
+
+  // sample tube
+  double sampleVolumeUl;    // uL of aqueous sample
+  double sampleConductance; // W/K, block to an empty tube
+
+  // heated lid
+  double lidCapacity;       // J/K
+  double lidLoss;           // W/K, lid to ambient
+  double lidBlockCoupling;  // W/K, lid to block through the tubes
+  double lidHeaterPower;    // W at full PWM
+
+  // thermistor lag
+  double plateSensorTau;    // s
+  double lidSensorTau;      // s
+};
+
+extern const SPlantParams DEFAULT_PLANT_PARAMS;
+
+////////////////////////////////////////////////////////////////////
+// Class ThermalPlant
+class ThermalPlant {
+public:
+  ThermalPlant(const SPlantParams& params);
+
+  void Reset();
+
+  //peltierDrive is the signed duty cycle, positive heats the block; lidDrive is 0..1
+  void Step(double dtS, double peltierDrive, double lidDrive);
+
+  // accessors
+  double GetBlockTemp() { return iBlockTemp; }
+  double GetSinkTemp() { return iSinkTemp; }
+  double GetSampleTemp() { return iSampleTemp; }
+  double GetLidTemp() { return iLidTemp; }
+  double GetPlateSensorTemp() { return iPlateSensorTemp; }
+  double GetLidSensorTemp() { return iLidSensorTemp; }
+  const SPlantParams& GetParams() { return iParams; }
+
+private:
+  SPlantParams iParams;
+  double iSampleCapacity;
+  double iSampleConductance;
+
+  double iBlockTemp;
+  double iSinkTemp;
+  double iSampleTemp;
+  double iLidTemp;
+  double iPlateSensorTemp;
+  double iLidSensorTemp;
+};
+
+#endif
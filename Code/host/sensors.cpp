@@ -0,0 +1,41 @@
+/*
+ *  sensors.cpp - thermistor divider model for the OpenPCR host build.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "sensors.h"
+
+#define KELVIN_OFFSET 273.15
+#define LID_ADC_FULL_SCALE 1024
+#define PLATE_ADC_FULL_SCALE 0x1FFFFF
+
+double ThermistorResistance(double tempC) {
+  return SENSOR_R25 * exp(SENSOR_BETA * (1.0 / (tempC + KELVIN_OFFSET) - 1.0 / (25 + KELVIN_OFFSET)));
+}
+
+static double DividerRatio(double tempC) {
+  double resistance = ThermistorResistance(tempC);
+  return resistance / (resistance + SENSOR_PULLUP);
+}
+
+double LidAdcFromTemp(double tempC) {
+  return DividerRatio(tempC) * LID_ADC_FULL_SCALE;
+}
+
+uint32_t PlateAdcCodeFromTemp(double tempC) {
+  return (uint32_t)(DividerRatio(tempC) * PLATE_ADC_FULL_SCALE + 0.5);
+}
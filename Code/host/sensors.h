@@ -0,0 +1,32 @@
+/*
+ *  sensors.h - thermistor divider model for the OpenPCR host build.
+ *
+ *  OpenPCR control software is free software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  OpenPCR control software is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  the OpenPCR control software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SENSORS_H_
+#define _SENSORS_H_
+
+#include <stdint.h>
+
+//NTC103A (Vishay NTCLE100E3103) in a divider with a 2k2 pull-up to 5V
+#define SENSOR_R25 10000.0
+#define SENSOR_BETA 3977.0
+#define SENSOR_PULLUP 2200.0
+
+double ThermistorResistance(double tempC);
+double LidAdcFromTemp(double tempC);        //10 bit AVR ADC input level, in codes
+uint32_t PlateAdcCodeFromTemp(double tempC); //21 bit LTC24xx conversion result
+
+#endif